@@ -40,12 +40,23 @@
 #define MSGID_NYX_QMUX_TP_INVALID_EVENT        "NYXTP_INVALID_EVENT"
 #define MSGID_NYX_QMUX_TP_TOOMANY_ITEMS_ERR    "NYXTP_TOOMANY_ITEMS_ERR"
 #define MSGID_NYX_QMUX_TP_OUT_OF_MEMORY        "NYXTP_OUT_OF_MEM_ERR"
+#define MSGID_NYX_QMUX_TP_TRACE_COUNTERS       "NYXTP_TRACE_COUNTERS"
+#define MSGID_NYX_QMUX_TP_EVENTS_DROPPED       "NYXTP_EVENTS_DROPPED"
+#define MSGID_NYX_QMUX_TP_SETTINGS_ERR         "NYXTP_SETTINGS_ERR"
+#define MSGID_NYX_QMUX_TP_SETTINGS_RELOAD      "NYXTP_SETTINGS_RELOAD"
+#define MSGID_NYX_QMUX_TP_EVENT_SOURCE_ERR     "NYXTP_EVENT_SOURCE_ERR"
+#define MSGID_NYX_QMUX_TP_READER_THREAD_ERR    "NYXTP_READER_THREAD_ERR"
+#define MSGID_NYX_QMUX_TP_INPUT_DROPPED        "NYXTP_INPUT_DROPPED"
 
 /** Keys */
 #define MSGID_NYX_QMUX_KEY_EVENT_ERR           "NYXKEY_EVENT_ERR"
 #define MSGID_NYX_QMUX_KEY_EVENT_READ_ERR      "NYXKEY_EVENT_READ_ERR"
 #define MSGID_NYX_QMUX_KEYS_OPEN_ERR           "NYXKEY_OPEN_ERR"
 #define MSGID_NYX_QMUX_KEY_OUT_OF_MEM          "NYXKEY_OUT_OF_MEM_ERR"
+#define MSGID_NYX_QMUX_KEYS_KEYMAP_ERR         "NYXKEY_KEYMAP_ERR"
+#define MSGID_NYX_QMUX_KEY_EVENT_SOURCE_ERR    "NYXKEY_EVENT_SOURCE_ERR"
+#define MSGID_NYX_QMUX_KEYS_SETTINGS_ERR       "NYXKEY_SETTINGS_ERR"
+#define MSGID_NYX_QMUX_KEYS_STATS              "NYXKEY_STATS"
 
 /**Battery lib*/
 #define MSGID_NYX_QMUX_BAT_OPEN_ERR            "NYXBAT_OPEN_ERR"
@@ -22,42 +22,41 @@
 #include <linux/input.h>
 #include <errno.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <limits.h>
+#include <time.h>
 #include <glib.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <assert.h>
+#include <string.h>
 
 #include <nyx/nyx_module.h>
 #include <nyx/module/nyx_utils.h>
 #include <nyx/module/nyx_log.h>
 #include "msgid.h"
+#include "keys_keymap.h"
+#include "keys_settings.h"
+#include "keys.h"
 
-enum
-{
-	F1 = 0x276C, /* Function keys */
-	F2 = 0x276D,
-	F3 = 0x276E,
-	F4 = 0x276F,
-	F5 = 0x2770,
-	F6 = 0x2771,
-	F7 = 0x2772,
-	F8 = 0x2773,
-	F9 = 0x2774,
-	F10 = 0x2775,
-	KEY_SYM = 0xf6,
-	KEY_ORANGE = 0x64
-};
+#ifndef KEYS_KEYMAP_FILE
+#define KEYS_KEYMAP_FILE "/etc/nyx-modules/keys.keymap"
+#endif
 
-int keypad_event_fd;
+#ifndef KEYS_SETTINGS_FILE
+#define KEYS_SETTINGS_FILE "/etc/nyx-modules/keys.conf"
+#endif
 
-typedef struct
-{
-	nyx_device_t _parent;
-	nyx_event_keys_t *current_event_ptr;
-} keys_device_t;
+/* where other keyboards are looked for */
+#ifndef KEYS_INPUT_DIR
+#define KEYS_INPUT_DIR "/dev/input"
+#endif
 
-NYX_DECLARE_MODULE(NYX_DEVICE_KEYS, "Keys");
+int keypad_event_fd;
 
 /**
  * This is modeled after the linux input event interface events.
@@ -71,24 +70,243 @@ typedef struct InputEvent
 	int32_t value;        /**< event value: coordinate, intensity,etc. */
 } InputEvent_t;
 
+/* raw events read from a keyboard at a time */
+#define MAX_EVENTS      64
+
+/* keyboards read at most, KEYPAD_INPUT_DEVICE and the ones discovered */
+#define KEYS_MAX_SOURCES        8
+
+/* events handed out at a time, more input waits until some are released */
+#define KEYS_EVENT_POOL_SIZE    64
 
-static nyx_event_keys_t *keys_event_create()
+/* key events read ahead of the caller, a power of 2 */
+#define KEYS_RING_SIZE          256
+
+/*
+ * Keys of Priority/Keys read ahead, a power of 2, and the events of the
+ * pool kept for them. Input is looked at for them at least every
+ * KEYS_PRIORITY_POLL events delivered, even if there are events left.
+ */
+#define KEYS_PRIORITY_RING_SIZE 16
+#define KEYS_PRIORITY_RESERVED  4
+#define KEYS_PRIORITY_POLL      64
+
+/* latencies above are taken for a kernel that doesn't time stamp with
+   CLOCK_MONOTONIC and aren't counted */
+#define KEYS_MAX_LATENCY_US     (10 * 1000000)
+#define KEYS_MAX_HELD_CHORDS    8
+
+/* unsigned longs of a bitmap of all evdev key codes, as EVIOCGKEY fills it */
+#define KEYS_KEY_LONGS          (KEY_MAX / (8 * sizeof(unsigned long)) + 1)
+
+/* how a key_input_t was pressed, see [Press] in keys.conf */
+enum
 {
-	nyx_event_keys_t *event_ptr = (nyx_event_keys_t *) calloc(
-	                                  sizeof(nyx_event_keys_t), 1);
+	KEYS_PRESS_NONE = 0,
+	KEYS_PRESS_LONG,            /**< reported as the [LongPress] key */
+	KEYS_PRESS_MULTI            /**< reported as the [MultiPress] key */
+};
 
-	if (NULL == event_ptr)
+/**
+ * A key event as read from the device, without the events around it.
+ */
+typedef struct
+{
+	struct timeval time;    /**< kernel time of the event */
+	uint16_t code;          /**< evdev key code */
+	int32_t value;          /**< 0 released, 1 pressed, 2 auto repeat */
+	uint16_t press;         /**< KEYS_PRESS_* */
+} key_input_t;
+
+/**
+ * A keyboard the module reads, with what was read from it and not yet moved
+ * to the ring.
+ */
+typedef struct
+{
+	int fd;
+	InputEvent_t raw_events[MAX_EVENTS];
+	int event_count;
+	int event_iter;
+	bool drained;           /**< had nothing more to read this time round */
+	unsigned int kernel_repeat[2];  /**< delay and period to restore, see
+                                         Repeat/Software */
+	bool kernel_repeat_saved;
+
+	/* what [Debounce] goes by, as delivered from this keyboard */
+	unsigned long keys_down[KEYS_KEY_LONGS];
+	unsigned long keys_bounced[KEYS_KEY_LONGS];  /**< presses dropped, their
+                                                      repeats and releases are too */
+	int last_press_code;        /**< -1 if none */
+	struct timeval last_press_time;     /**< kernel time */
+} keys_source_t;
+
+typedef struct
+{
+	nyx_device_t _parent;
+	keymap_t keymap;
+	keymap_chords_t chords;
+	keymap_presses_t long_presses;
+	keymap_presses_t multi_presses;
+	keys_settings_t settings;
+
+	keys_source_t sources[KEYS_MAX_SOURCES];
+	int num_sources;
+
+	nyx_event_keys_t event_pool[KEYS_EVENT_POOL_SIZE];
+	nyx_event_keys_t *free_events[KEYS_EVENT_POOL_SIZE];
+	int num_free_events;
+	bool event_in_use[KEYS_EVENT_POOL_SIZE];     /**< handed out, not released */
+	bool event_is_priority[KEYS_EVENT_POOL_SIZE];
+
+	key_input_t ring[KEYS_RING_SIZE];
+	unsigned int ring_head;     /**< next to deliver, runs freely */
+	unsigned int ring_tail;     /**< next to fill, runs freely */
+
+	/* the keys of Priority/Keys, delivered before the ring */
+	key_input_t priority_ring[KEYS_PRIORITY_RING_SIZE];
+	unsigned int priority_head;
+	unsigned int priority_tail;
+	unsigned long priority_held[KEYS_PRESS_MULTI + 1][KEYS_KEY_LONGS];  /**< by
+                                         press kind, pressed in it and not
+                                         yet released */
+	unsigned int priority_owed;     /**< slots kept for their releases */
+
+	keys_stats_t stats;
+
+	/*
+	 * What keys_get_event_source() hands out: an epoll set of the keyboards
+	 * and queue_signal_fd, an eventfd that is readable while there are events
+	 * to deliver. If it can't be set up keypad_event_fd is handed out instead.
+	 */
+	int event_source_fd;
+	int queue_signal_fd;
+	bool queue_signalled;
+
+	/*
+	 * Also in the event source while software repeat or long presses are on,
+	 * a timerfd armed at the next repeat or long press that is due.
+	 */
+	int timer_fd;
+	bool timer_armed;
+
+	/* software key repeat, see Repeat/Software */
+	int repeat_code;            /**< evdev code of the held key, -1 if none */
+	keys_source_t *repeat_source;   /**< keyboard the key is held on */
+	int repeat_interval;        /**< ms */
+	int64_t repeat_deadline;    /**< ms of CLOCK_MONOTONIC the next repeat is due */
+	int queued_repeats;         /**< repeats in the ring */
+
+	/* long and multi presses, see [Press] */
+	int press_code;             /**< evdev code of the key pressed last, -1 if
+                                     none */
+	keys_source_t *press_source;
+	bool press_held;
+	bool press_long;            /**< its long press was reported */
+	int press_count;            /**< presses in a row so far */
+	int64_t press_deadline;     /**< ms of CLOCK_MONOTONIC the long press or the
+                                     next hold is due while held */
+	int64_t press_released;     /**< kernel time in ms the key was released,
+                                     the multi press times out from */
+
+	/* as of the last event returned */
+	uint32_t modifiers_held;    /**< KEYS_MODIFIER_* of left hand keys, those of
+                                     right hand keys shifted up by 16 */
+	struct
+	{
+		uint16_t code;
+		keymap_entry_t entry;
+	} held_chords[KEYS_MAX_HELD_CHORDS];  /**< chords pressed, until released */
+	int num_held_chords;
+} keys_device_t;
+
+/*
+ * Built-in defaults, overridden by KEYS_SETTINGS_FILE when the module is
+ * opened.
+ */
+static const keys_settings_t sDefaultSettings =
+{
+	.softwareRepeat = 0,
+	.repeatDelay = 500,
+	.repeatInterval = 33,
+	.customRepeatDelay = 500,
+	.customRepeatInterval = 100,
+	.maxQueuedRepeats = 4,
+	.longPress = 0,
+	.holdInterval = 0,
+	.multiPress = 0,
+	.debounceWindow = 0,
+	.priorityKeys = 1u << NYX_KEYS_CUSTOM_KEY_POWER_ON
+};
+
+static void update_event_source(keys_device_t *keys_device);
+static int64_t next_deadline(keys_device_t *keys_device);
+
+NYX_DECLARE_MODULE(NYX_DEVICE_KEYS, "Keys");
+
+static void keys_event_pool_init(keys_device_t *keys_device)
+{
+	int i;
+
+	for (i = 0; i < KEYS_EVENT_POOL_SIZE; i++)
+	{
+		keys_device->free_events[i] = &keys_device->event_pool[i];
+	}
+
+	keys_device->num_free_events = KEYS_EVENT_POOL_SIZE;
+}
+
+/*
+ * Returns the slot of the pool an event handed out is in, or -1 if it is not
+ * one of the pool.
+ */
+static int keys_event_slot(const keys_device_t *keys_device,
+                           const nyx_event_t *e)
+{
+	uintptr_t offset = (uintptr_t) e - (uintptr_t) keys_device->event_pool;
+
+	if (offset >= sizeof(keys_device->event_pool) ||
+	        offset % sizeof(keys_device->event_pool[0]) != 0)
+	{
+		return -1;
+	}
+
+	return offset / sizeof(keys_device->event_pool[0]);
+}
+
+/*
+ * Takes an event from the pool. The last KEYS_PRIORITY_RESERVED ones are
+ * only handed out for priority keys, so they get through even while the
+ * caller holds on to the others. Returns NULL if none is left for the key.
+ */
+static nyx_event_keys_t *keys_event_create(keys_device_t *keys_device,
+        bool priority)
+{
+	nyx_event_keys_t *event_ptr;
+
+	if (keys_device->num_free_events <= (priority ? 0 : KEYS_PRIORITY_RESERVED))
 	{
-		return event_ptr;
+		return NULL;
 	}
 
+	event_ptr = keys_device->free_events[--keys_device->num_free_events];
+	memset(event_ptr, 0, sizeof(*event_ptr));
 	((nyx_event_t *) event_ptr)->type = NYX_EVENT_KEYS;
+	keys_device->event_in_use[event_ptr - keys_device->event_pool] = true;
+	keys_device->event_is_priority[event_ptr - keys_device->event_pool] = priority;
 
 	return event_ptr;
 }
 
+/*
+ * Returns an event to the pool. Events are part of the device, they must all
+ * be released before nyx_module_close().
+ */
 nyx_error_t keys_release_event(nyx_device_t *d, nyx_event_t *e)
 {
+	keys_device_t *keys_device = (keys_device_t *) d;
+	int slot;
+
 	if (NULL == d)
 	{
 		return NYX_ERROR_INVALID_HANDLE;
@@ -99,9 +317,19 @@ nyx_error_t keys_release_event(nyx_device_t *d, nyx_event_t *e)
 		return NYX_ERROR_INVALID_HANDLE;
 	}
 
-	nyx_event_keys_t *a = (nyx_event_keys_t *) e;
+	slot = keys_event_slot(keys_device, e);
+
+	/* not handed out, or released already */
+	if (slot < 0 || !keys_device->event_in_use[slot])
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	keys_device->event_in_use[slot] = false;
+	keys_device->free_events[keys_device->num_free_events++] =
+	    &keys_device->event_pool[slot];
+	update_event_source(keys_device);
 
-	free(a);
 	return NYX_ERROR_NONE;
 }
 
@@ -110,7 +338,7 @@ static int
 init_keypad(void)
 {
 #ifdef KEYPAD_INPUT_DEVICE
-	keypad_event_fd = open(KEYPAD_INPUT_DEVICE, O_RDWR);
+	keypad_event_fd = open(KEYPAD_INPUT_DEVICE, O_RDWR | O_NONBLOCK);
 
 	if (keypad_event_fd < 0)
 	{
@@ -124,309 +352,1425 @@ init_keypad(void)
 #endif
 }
 
-nyx_error_t nyx_module_open(nyx_instance_t i, nyx_device_t **d)
+#define test_key_bit(bits, bit) \
+  (((bits)[(bit) / (8 * sizeof((bits)[0]))] >> \
+    ((bit) % (8 * sizeof((bits)[0])))) & 1)
+#define set_key_bit(bits, bit) \
+  ((bits)[(bit) / (8 * sizeof((bits)[0]))] |= \
+     1UL << ((bit) % (8 * sizeof((bits)[0]))))
+#define clear_key_bit(bits, bit) \
+  ((bits)[(bit) / (8 * sizeof((bits)[0]))] &= \
+     ~(1UL << ((bit) % (8 * sizeof((bits)[0])))))
+
+/*
+ * Keyboards and power buttons have keys, but no buttons. Pointers and
+ * touchscreens have buttons and belong to the touchpanel module.
+ */
+static bool
+is_keyboard(int fd)
 {
-	if (NULL == d)
+	unsigned long keys[KEY_MAX / (8 * sizeof(unsigned long)) + 1] = { 0 };
+
+	if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0)
 	{
-	    nyx_error(MSGID_NYX_QMUX_KEYS_OPEN_ERR, 0,"Keys device  open error.");
-	    return NYX_ERROR_INVALID_VALUE;
+		return false;
 	}
 
-	keys_device_t *keys_device = (keys_device_t *) calloc(sizeof(keys_device_t),
-	                             1);
-
-	if (G_UNLIKELY(!keys_device))
+	if (test_key_bit(keys, BTN_TOUCH) || test_key_bit(keys, BTN_LEFT))
 	{
-		nyx_error(MSGID_NYX_QMUX_KEY_OUT_OF_MEM, 0, "Out of memory");
-		return NYX_ERROR_OUT_OF_MEMORY;
+		return false;
 	}
 
-	init_keypad();
-
-	nyx_module_register_method(i, (nyx_device_t *) keys_device,
-	                           NYX_GET_EVENT_SOURCE_MODULE_METHOD, "keys_get_event_source");
-	nyx_module_register_method(i, (nyx_device_t *) keys_device,
-	                           NYX_GET_EVENT_MODULE_METHOD, "keys_get_event");
-	nyx_module_register_method(i, (nyx_device_t *) keys_device,
-	                           NYX_RELEASE_EVENT_MODULE_METHOD, "keys_release_event");
-
-	*d = (nyx_device_t *) keys_device;
-
-	return NYX_ERROR_NONE;
-
+	return test_key_bit(keys, KEY_POWER) || test_key_bit(keys, KEY_A) ||
+	       test_key_bit(keys, KEY_VOLUMEUP);
 }
 
-nyx_error_t nyx_module_close(nyx_device_t *d)
+static void
+add_source(keys_device_t *keys_device, int fd)
 {
-	keys_device_t *keys_device = (keys_device_t *) d;
+	keys_source_t *source = &keys_device->sources[keys_device->num_sources];
+	int clock = CLOCK_MONOTONIC;
 
-	if (NULL == d)
+	/*
+	 * Events of different keyboards are merged by their timestamps, which
+	 * should not jump when the wall clock is set.
+	 */
+	(void)ioctl(fd, EVIOCSCLOCKID, &clock);
+
+	source->fd = fd;
+	source->event_count = 0;
+	source->event_iter = 0;
+	source->kernel_repeat_saved = false;
+	source->last_press_code = -1;
+	memset(source->keys_bounced, 0, sizeof(source->keys_bounced));
+
+	/* keys held already are released later on */
+	if (keys_device->settings.debounceWindow == 0 ||
+	        ioctl(fd, EVIOCGKEY(sizeof(source->keys_down)), source->keys_down) < 0)
 	{
-		return NYX_ERROR_INVALID_HANDLE;
+		memset(source->keys_down, 0, sizeof(source->keys_down));
 	}
 
-	if (keys_device->current_event_ptr)
+	/*
+	 * The module repeats keys itself, turn off the repeat of the kernel.
+	 * Its repeats are dropped anyway in case that doesn't work.
+	 */
+	if (keys_device->settings.softwareRepeat &&
+	        ioctl(fd, EVIOCGREP, source->kernel_repeat) == 0)
 	{
-		keys_release_event(d, (nyx_event_t *) keys_device->current_event_ptr);
-	}
+		unsigned int off[2] = { 0, 0 };
 
-	nyx_debug("Freeing keys %p", d);
-	free(d);
+		source->kernel_repeat_saved = ioctl(fd, EVIOCSREP, off) == 0;
+	}
 
-	return NYX_ERROR_NONE;
+	keys_device->num_sources++;
 }
 
-nyx_error_t keys_get_event_source(nyx_device_t *d, int *f)
+static void
+remove_sources(keys_device_t *keys_device)
 {
-	if (NULL == d)
-	{
-		return NYX_ERROR_INVALID_HANDLE;
-	}
+	int i;
 
-	if (NULL == f)
+	for (i = 0; i < keys_device->num_sources; i++)
 	{
-		return NYX_ERROR_INVALID_VALUE;
-	}
+		keys_source_t *source = &keys_device->sources[i];
+
+		if (source->fd < 0)
+		{
+			continue;
+		}
 
-	*f = keypad_event_fd;
+		if (source->kernel_repeat_saved)
+		{
+			(void)ioctl(source->fd, EVIOCSREP, source->kernel_repeat);
+		}
 
-	return NYX_ERROR_NONE;
+		/* keypad_event_fd stays open, as it always has */
+		if (source->fd != keypad_event_fd)
+		{
+			close(source->fd);
+		}
+	}
+
+	keys_device->num_sources = 0;
 }
 
-static int lookup_key(keys_device_t *d, uint16_t keyCode, int32_t keyValue,
-                      nyx_key_type_t *key_type_out_ptr)
+/*
+ * Adds the keyboards in KEYS_INPUT_DIR other than keypad_event_fd, so that
+ * e.g. a PS/2 keyboard and a power button are read next to the virtio one.
+ */
+static void
+discover_keyboards(keys_device_t *keys_device)
 {
-	int key = 0;
+	struct stat primary = { 0 };
+	struct dirent *entry;
+	DIR *dir = opendir(KEYS_INPUT_DIR);
 
-	switch (keyCode)
+	if (NULL == dir)
 	{
-		case KEY_Q:
-			key = NYX_KEYS_CUSTOM_KEY_HOME;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
-
-		case KEY_HOMEPAGE:
-		case KEY_W:
-			key = NYX_KEYS_CUSTOM_KEY_HOT;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
-
-		case KEY_BACK:
-		case KEY_E:
-			key = NYX_KEYS_CUSTOM_KEY_BACK;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
-
-		case KEY_HOME:
-			key = NYX_KEYS_CUSTOM_KEY_HOME;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		nyx_debug("Not looking for more keyboards: %d", errno);
+		return;
+	}
 
-		case KEY_VOLUMEUP:
-			key = NYX_KEYS_CUSTOM_KEY_VOL_UP;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	if (keypad_event_fd >= 0)
+	{
+		(void)fstat(keypad_event_fd, &primary);
+	}
 
-		case KEY_VOLUMEDOWN:
-			key = NYX_KEYS_CUSTOM_KEY_VOL_DOWN;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	while (keys_device->num_sources < KEYS_MAX_SOURCES &&
+	        NULL != (entry = readdir(dir)))
+	{
+		char path[PATH_MAX];
+		struct stat st;
+		int fd;
 
-		case KEY_END:
-			key = NYX_KEYS_CUSTOM_KEY_POWER_ON;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		if (strncmp(entry->d_name, "event", 5) != 0)
+		{
+			continue;
+		}
 
-		case KEY_PLAY:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_PLAY;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		snprintf(path, sizeof(path), "%s/%s", KEYS_INPUT_DIR, entry->d_name);
+		fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
 
-		case KEY_PAUSE:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_PAUSE;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		if (fd < 0)
+		{
+			continue;
+		}
 
-		case KEY_STOP:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_STOP;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		if (fstat(fd, &st) < 0 ||
+		        (keypad_event_fd >= 0 && st.st_rdev == primary.st_rdev) ||
+		        !is_keyboard(fd))
+		{
+			close(fd);
+			continue;
+		}
 
-		case KEY_NEXT:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_NEXT;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+		nyx_debug("Reading keys from %s too", path);
+		add_source(keys_device, fd);
+	}
 
-		case KEY_PREVIOUS:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_PREVIOUS;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	closedir(dir);
+}
 
-		// add keyboard function keys
-		case KEY_SEARCH:
-			key = NYX_KEYS_CUSTOM_KEY_SEARCH;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+static void
+deinit_event_source(keys_device_t *keys_device)
+{
+	if (keys_device->event_source_fd >= 0)
+	{
+		close(keys_device->event_source_fd);
+		keys_device->event_source_fd = -1;
+	}
 
-		case KEY_BRIGHTNESSDOWN:
-			key = NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_DOWN;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	if (keys_device->queue_signal_fd >= 0)
+	{
+		close(keys_device->queue_signal_fd);
+		keys_device->queue_signal_fd = -1;
+	}
 
-		case KEY_BRIGHTNESSUP:
-			key = NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_UP;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	if (keys_device->timer_fd >= 0)
+	{
+		close(keys_device->timer_fd);
+		keys_device->timer_fd = -1;
+	}
 
-		case KEY_MUTE:
-			key = NYX_KEYS_CUSTOM_KEY_VOL_MUTE;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	keys_device->queue_signalled = false;
+	keys_device->timer_armed = false;
+}
 
-		case KEY_REWIND:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_REWIND;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+static int
+init_event_source(keys_device_t *keys_device)
+{
+	struct epoll_event event = { .events = EPOLLIN };
+	int i;
 
-		case KEY_FASTFORWARD:
-			key = NYX_KEYS_CUSTOM_KEY_MEDIA_FASTFORWARD;
-			*key_type_out_ptr = NYX_KEY_TYPE_CUSTOM;
-			break;
+	keys_device->event_source_fd = epoll_create1(EPOLL_CLOEXEC);
+	keys_device->queue_signal_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-		default:
-			break;
+	if (keys_device->event_source_fd < 0 || keys_device->queue_signal_fd < 0)
+	{
+		goto error;
 	}
 
-	if (*key_type_out_ptr != NYX_KEY_TYPE_CUSTOM)
+	if (keys_device->settings.softwareRepeat || keys_device->settings.longPress)
 	{
-		if (keyCode == KEY_LEFTSHIFT)
+		keys_device->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+		                               TFD_NONBLOCK | TFD_CLOEXEC);
+		event.data.fd = keys_device->timer_fd;
+
+		if (keys_device->timer_fd < 0 ||
+		        epoll_ctl(keys_device->event_source_fd, EPOLL_CTL_ADD,
+		                  keys_device->timer_fd, &event) < 0)
 		{
-			key = KEY_LEFTSHIFT;
+			goto error;
 		}
-		else
+	}
+
+	for (i = 0; i < keys_device->num_sources; i++)
+	{
+		event.data.fd = keys_device->sources[i].fd;
+
+		if (epoll_ctl(keys_device->event_source_fd, EPOLL_CTL_ADD,
+		              keys_device->sources[i].fd, &event) < 0)
 		{
-			key = keyCode;
+			goto error;
 		}
 	}
 
-	return key;
-}
+	event.data.fd = keys_device->queue_signal_fd;
+
+	if (epoll_ctl(keys_device->event_source_fd, EPOLL_CTL_ADD,
+	              keys_device->queue_signal_fd, &event) < 0)
+	{
+		goto error;
+	}
+
+	return 0;
 
-struct pollfd fds[1];
+error:
+	nyx_error(MSGID_NYX_QMUX_KEY_EVENT_SOURCE_ERR, 0,
+	          "Failed to set up the event source: %d", errno);
+	deinit_event_source(keys_device);
+	return -1;
+}
 
-int
-read_input_event(InputEvent_t *pEvents, int maxEvents)
+/*
+ * Keeps queue_signal_fd readable for as long as keys_get_event() has events
+ * it can deliver right away, so that the caller comes back for them without
+ * waiting for the next keystroke.
+ */
+static void
+update_event_source(keys_device_t *keys_device)
 {
-	int numEvents = 0;
-	int rd = 0;
+	bool queued = keys_device->ring_tail != keys_device->ring_head;
+	uint64_t count = 1;
+	int i;
 
-	if (pEvents == NULL)
+	/* read from a keyboard already, but not moved to the ring yet */
+	for (i = 0; !queued && i < keys_device->num_sources; i++)
 	{
-		return -1;
+		queued = keys_device->sources[i].event_iter <
+		         keys_device->sources[i].event_count;
 	}
 
-	fds[0].fd = keypad_event_fd;
-	fds[0].events = POLLIN;
+	queued = queued && keys_device->num_free_events > KEYS_PRIORITY_RESERVED;
+	queued = queued || (keys_device->priority_tail != keys_device->priority_head &&
+	                    keys_device->num_free_events > 0);
 
-	int ret_val = poll(fds, 1, 0);
-
-	if (ret_val <= 0)
+	if (keys_device->queue_signal_fd >= 0 && queued != keys_device->queue_signalled)
 	{
-		return 0;
+		/* the eventfd is readable as long as its count isn't 0 */
+		if (queued)
+		{
+			(void)write(keys_device->queue_signal_fd, &count, sizeof(count));
+		}
+		else
+		{
+			(void)read(keys_device->queue_signal_fd, &count, sizeof(count));
+		}
+
+		keys_device->queue_signalled = queued;
 	}
 
-	if (fds[0].revents & POLLIN)
+	if (keys_device->timer_fd >= 0)
 	{
-		/* keep looping if get EINTR */
-		for (;;)
-		{
-			rd = read(fds[0].fd, pEvents, sizeof(InputEvent_t) * maxEvents);
+		struct itimerspec timer = { { 0, 0 }, { 0, 0 } };
+		int64_t deadline = next_deadline(keys_device);
 
-			if (rd > 0)
-			{
-				numEvents += rd / sizeof(InputEvent_t);
-				break;
-			}
-			else if (rd < 0 && errno != EINTR)
-			{
-				nyx_error(MSGID_NYX_QMUX_KEY_EVENT_READ_ERR, 0, "Failed to read events from keypad event file");
-				return -1;
-			}
+		if (deadline != INT64_MAX)
+		{
+			timer.it_value.tv_sec = deadline / 1000;
+			timer.it_value.tv_nsec = (deadline % 1000) * 1000000L;
+		}
+		else if (!keys_device->timer_armed)
+		{
+			return;
 		}
-	}
 
-	return numEvents;
+		timerfd_settime(keys_device->timer_fd, TFD_TIMER_ABSTIME, &timer,
+		                NULL);
+		keys_device->timer_armed = deadline != INT64_MAX;
+	}
 }
 
-#define MAX_EVENTS      64
-
-nyx_error_t keys_get_event(nyx_device_t *d, nyx_event_t **e)
+nyx_error_t nyx_module_open(nyx_instance_t i, nyx_device_t **d)
 {
-	static InputEvent_t raw_events[MAX_EVENTS];
-
-	static int event_count = 0;
-	static int event_iter = 0;
+	if (NULL == d)
+	{
+	    nyx_error(MSGID_NYX_QMUX_KEYS_OPEN_ERR, 0,"Keys device  open error.");
+	    return NYX_ERROR_INVALID_VALUE;
+	}
 
-	keys_device_t *keys_device = (keys_device_t *) d;
+	keys_device_t *keys_device = (keys_device_t *) calloc(sizeof(keys_device_t),
+	                             1);
 
-	/*
-	 * Event bookkeeping...
-	 */
-	if (!event_iter)
+	if (G_UNLIKELY(!keys_device))
 	{
-		event_count = read_input_event(raw_events, MAX_EVENTS);
-		keys_device->current_event_ptr = NULL;
+		nyx_error(MSGID_NYX_QMUX_KEY_OUT_OF_MEM, 0, "Out of memory");
+		return NYX_ERROR_OUT_OF_MEMORY;
 	}
 
-	if (keys_device->current_event_ptr == NULL)
+	keys_device->event_source_fd = -1;
+	keys_device->queue_signal_fd = -1;
+	keys_device->timer_fd = -1;
+	keys_device->repeat_code = -1;
+	keys_device->press_code = -1;
+	keys_device->settings = sDefaultSettings;
+
+	if (access(KEYS_SETTINGS_FILE, F_OK) == 0)
 	{
-		/*
-		 * let's allocate new event and hold it here.
-		 */
-		keys_device->current_event_ptr = keys_event_create();
-		assert(NULL != keys_device->current_event_ptr);
+		load_keys_settings(KEYS_SETTINGS_FILE, &keys_device->settings);
 	}
 
-	for (; event_iter < event_count;)
+	if (init_keypad() == 0)
 	{
-		InputEvent_t *input_event_ptr;
-		input_event_ptr = &raw_events[event_iter];
-		event_iter++;
-
-		if (input_event_ptr->type == EV_KEY)
-		{
-			keys_device->current_event_ptr->key_type = NYX_KEY_TYPE_STANDARD;
-			keys_device->current_event_ptr->key = lookup_key(keys_device,
-			                                      input_event_ptr->code, input_event_ptr->value,
-			                                      &keys_device->current_event_ptr->key_type);
-		}
-		else
-		{
-			continue;
-		}
-
-		keys_device->current_event_ptr->key_is_press
-		    = (input_event_ptr->value) ? true : false;
-		keys_device->current_event_ptr->key_is_auto_repeat
-		    = (input_event_ptr->value > 1) ? true : false;
+		add_source(keys_device, keypad_event_fd);
+	}
 
-		*e = (nyx_event_t *) keys_device->current_event_ptr;
-		keys_device->current_event_ptr = NULL;
+	discover_keyboards(keys_device);
 
-		/*
-		 * Generated event, bail out and let the caller know.
-		 */
-		if (NULL != *e)
-		{
-			break;
-		}
+	if (keys_device->num_sources > 0 && init_event_source(keys_device) < 0)
+	{
+		nyx_error(MSGID_NYX_QMUX_KEY_EVENT_SOURCE_ERR, 0,
+		          "Falling back to the device as event source");
 	}
 
-	if (event_iter >= event_count)
+	keys_event_pool_init(keys_device);
+	keymap_init_defaults(keys_device->keymap);
+
+	if (access(KEYS_KEYMAP_FILE, F_OK) == 0)
 	{
-		event_iter = 0;
+		keymap_load(KEYS_KEYMAP_FILE, keys_device->keymap, &keys_device->chords,
+		            &keys_device->long_presses, &keys_device->multi_presses);
 	}
 
+	nyx_module_register_method(i, (nyx_device_t *) keys_device,
+	                           NYX_GET_EVENT_SOURCE_MODULE_METHOD, "keys_get_event_source");
+	nyx_module_register_method(i, (nyx_device_t *) keys_device,
+	                           NYX_GET_EVENT_MODULE_METHOD, "keys_get_event");
+#ifdef HAVE_NYX_GET_EVENTS_MODULE_METHOD
+	nyx_module_register_method(i, (nyx_device_t *) keys_device,
+	                           NYX_GET_EVENTS_MODULE_METHOD, "keys_get_events");
+#endif
+	nyx_module_register_method(i, (nyx_device_t *) keys_device,
+	                           NYX_RELEASE_EVENT_MODULE_METHOD, "keys_release_event");
+
+	*d = (nyx_device_t *) keys_device;
+
+	return NYX_ERROR_NONE;
+
+}
+
+static void
+log_latency(const char *pLane, const keys_latency_t *latency)
+{
+	if (latency->count > 0)
+	{
+		nyx_info(MSGID_NYX_QMUX_KEYS_STATS, 0,
+		         "%s keys: %u, latency avg %llu us, max %u us", pLane, latency->count,
+		         (unsigned long long)(latency->total_us / latency->count),
+		         latency->max_us);
+	}
+}
+
+static void
+log_stats(keys_device_t *keys_device)
+{
+	log_latency("Priority", &keys_device->stats.priority);
+	log_latency("Standard", &keys_device->stats.standard);
+
+	if (keys_device->stats.bounces > 0 || keys_device->stats.duplicates > 0)
+	{
+		nyx_info(MSGID_NYX_QMUX_KEYS_STATS, 0,
+		         "Debounce: %u bounces, %u duplicates dropped",
+		         keys_device->stats.bounces, keys_device->stats.duplicates);
+	}
+}
+
+nyx_error_t nyx_module_close(nyx_device_t *d)
+{
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	deinit_event_source((keys_device_t *) d);
+	remove_sources((keys_device_t *) d);
+	log_stats((keys_device_t *) d);
+
+	/* they go away with the device, releasing them later is a use after free */
+	if (((keys_device_t *) d)->num_free_events < KEYS_EVENT_POOL_SIZE)
+	{
+		nyx_error(MSGID_NYX_QMUX_KEY_EVENT_ERR, 0,
+		          "Closing with %d events not released",
+		          KEYS_EVENT_POOL_SIZE - ((keys_device_t *) d)->num_free_events);
+	}
+
+	nyx_debug("Freeing keys %p", d);
+	free(d);
+
+	return NYX_ERROR_NONE;
+}
+
+nyx_error_t keys_get_event_source(nyx_device_t *d, int *f)
+{
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == f)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	keys_device_t *keys_device = (keys_device_t *) d;
+
+	*f = keys_device->event_source_fd >= 0 ? keys_device->event_source_fd :
+	     keypad_event_fd;
+
+	return NYX_ERROR_NONE;
+}
+
+/*
+ * Returns the bit of modifiers_held the key sets while held down, 0 if it
+ * isn't a modifier. The keys reported as Sym or Orange are modifiers too.
+ * KEY_ORANGE is the code of KEY_RIGHTALT, so right Alt is Orange rather
+ * than Alt.
+ */
+static uint32_t
+modifier_key_bit(const keys_device_t *keys_device, uint16_t code)
+{
+	const keymap_entry_t *entry;
+
+	if (code >= KEY_CNT)
+	{
+		return 0;
+	}
+
+	entry = &keys_device->keymap[code];
+
+	if (entry->type == NYX_KEY_TYPE_STANDARD && entry->key == KEY_SYM)
+	{
+		return KEYS_MODIFIER_SYM;
+	}
+
+	if (entry->type == NYX_KEY_TYPE_STANDARD && entry->key == KEY_ORANGE)
+	{
+		return KEYS_MODIFIER_ORANGE;
+	}
+
+	switch (code)
+	{
+		case KEY_LEFTSHIFT:
+			return KEYS_MODIFIER_SHIFT;
+
+		case KEY_RIGHTSHIFT:
+			return KEYS_MODIFIER_SHIFT << 16;
+
+		case KEY_LEFTCTRL:
+			return KEYS_MODIFIER_CTRL;
+
+		case KEY_RIGHTCTRL:
+			return KEYS_MODIFIER_CTRL << 16;
+
+		case KEY_LEFTALT:
+			return KEYS_MODIFIER_ALT;
+
+		case KEY_LEFTMETA:
+			return KEYS_MODIFIER_META;
+
+		case KEY_RIGHTMETA:
+			return KEYS_MODIFIER_META << 16;
+
+		default:
+			return 0;
+	}
+}
+
+static uint32_t
+current_modifiers(const keys_device_t *keys_device)
+{
+	return (keys_device->modifiers_held | keys_device->modifiers_held >> 16) &
+	       0xffff;
+}
+
+static int lookup_key(keys_device_t *d, uint16_t keyCode, int32_t keyValue,
+                      nyx_key_type_t *key_type_out_ptr)
+{
+	if (keyCode >= KEY_CNT)
+	{
+		return keyCode;
+	}
+
+	*key_type_out_ptr = d->keymap[keyCode].type;
+
+	return d->keymap[keyCode].key;
+}
+
+/*
+ * Returns the chord a key press makes with the modifiers held down, NULL if
+ * it makes none.
+ */
+static const keymap_chord_t *
+lookup_chord(keys_device_t *d, uint16_t keyCode)
+{
+	uint32_t modifiers = current_modifiers(d);
+	int i;
+
+	if (modifiers == 0)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < d->chords.num_chords; i++)
+	{
+		if (d->chords.chords[i].code == keyCode &&
+		        d->chords.chords[i].modifiers == modifiers)
+		{
+			return &d->chords.chords[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Fills in the key of an event, keeping track of the modifiers on the way.
+ * A key pressed as part of a chord is reported as the chord, and so are its
+ * repeats and release, whatever happens to the modifiers in the meantime.
+ */
+static void
+decode_key(keys_device_t *d, const key_input_t *input_ptr,
+           nyx_event_keys_t *event_ptr)
+{
+	uint32_t modifier;
+	int i;
+
+	event_ptr->key_type = NYX_KEY_TYPE_STANDARD;
+	event_ptr->key = lookup_key(d, input_ptr->code, input_ptr->value,
+	                            &event_ptr->key_type);
+
+	if (input_ptr->press != KEYS_PRESS_NONE)
+	{
+		const keymap_entry_t *entry = keymap_find_press(
+		                                  input_ptr->press == KEYS_PRESS_LONG ?
+		                                  &d->long_presses : &d->multi_presses,
+		                                  input_ptr->code);
+
+		if (entry != NULL)
+		{
+			event_ptr->key = entry->key;
+			event_ptr->key_type = entry->type;
+		}
+
+		return;
+	}
+
+	if (input_ptr->code >= KEY_CNT)
+	{
+		return;
+	}
+
+	modifier = modifier_key_bit(d, input_ptr->code);
+
+	if (modifier != 0)
+	{
+		if (input_ptr->value)
+		{
+			d->modifiers_held |= modifier;
+		}
+		else
+		{
+			d->modifiers_held &= ~modifier;
+		}
+
+		return;
+	}
+
+	for (i = 0; i < d->num_held_chords; i++)
+	{
+		if (d->held_chords[i].code == input_ptr->code)
+		{
+			break;
+		}
+	}
+
+	if (i == d->num_held_chords)
+	{
+		const keymap_chord_t *chord;
+
+		if (input_ptr->value != 1 || d->num_held_chords == KEYS_MAX_HELD_CHORDS)
+		{
+			return;
+		}
+
+		chord = lookup_chord(d, input_ptr->code);
+
+		if (NULL == chord)
+		{
+			return;
+		}
+
+		d->held_chords[d->num_held_chords].code = input_ptr->code;
+		d->held_chords[d->num_held_chords].entry = chord->entry;
+		d->num_held_chords++;
+	}
+
+	event_ptr->key = d->held_chords[i].entry.key;
+	event_ptr->key_type = d->held_chords[i].entry.type;
+
+	if (input_ptr->value == 0)
+	{
+		d->held_chords[i] = d->held_chords[--d->num_held_chords];
+	}
+}
+
+/*
+ * Returns the next key event of a keyboard, reading more from it once what
+ * was read before is used up, or NULL if it has none right now.
+ */
+static InputEvent_t *
+source_peek(keys_source_t *source)
+{
+	for (;;)
+	{
+		ssize_t rd;
+
+		for (; source->event_iter < source->event_count; source->event_iter++)
+		{
+			if (source->raw_events[source->event_iter].type == EV_KEY)
+			{
+				return &source->raw_events[source->event_iter];
+			}
+		}
+
+		if (source->drained || source->fd < 0)
+		{
+			return NULL;
+		}
+
+		rd = read(source->fd, source->raw_events, sizeof(source->raw_events));
+
+		if (rd < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if (errno == ENODEV && source->fd != keypad_event_fd)
+			{
+				/* unplugged, closing it also takes it out of the event source */
+				nyx_debug("Keyboard went away");
+				close(source->fd);
+				source->fd = -1;
+			}
+			else if (errno != EAGAIN)
+			{
+				nyx_error(MSGID_NYX_QMUX_KEY_EVENT_READ_ERR, 0, "Failed to read events from keypad event file");
+			}
+
+			rd = 0;
+		}
+
+		source->event_count = rd / sizeof(InputEvent_t);
+		source->event_iter = 0;
+
+		/* a short read means the keyboard has nothing more right now */
+		source->drained = (size_t) rd < sizeof(source->raw_events);
+	}
+}
+
+/*
+ * Tells whether a key event read from a keyboard is dropped by [Debounce]:
+ * a press of a key that is held or a release of a key that is not, and a
+ * press of the key pressed last within Debounce/Window of that press by the
+ * time stamps of the kernel, with its repeats and release.
+ */
+static bool
+debounce(keys_device_t *keys_device, keys_source_t *source,
+         const InputEvent_t *event_ptr)
+{
+	uint16_t code = event_ptr->code;
+	struct timeval elapsed;
+	int64_t ms;
+
+	if (keys_device->settings.debounceWindow == 0 || code > KEY_MAX)
+	{
+		return false;
+	}
+
+	if (test_key_bit(source->keys_bounced, code))
+	{
+		if (event_ptr->value == 0)
+		{
+			clear_key_bit(source->keys_bounced, code);
+		}
+
+		return true;
+	}
+
+	if (event_ptr->value > 1)
+	{
+		return false;
+	}
+
+	if (event_ptr->value == 0)
+	{
+		if (!test_key_bit(source->keys_down, code))
+		{
+			keys_device->stats.duplicates++;
+			return true;
+		}
+
+		clear_key_bit(source->keys_down, code);
+		return false;
+	}
+
+	if (test_key_bit(source->keys_down, code))
+	{
+		keys_device->stats.duplicates++;
+		return true;
+	}
+
+	timersub(&event_ptr->time, &source->last_press_time, &elapsed);
+	ms = (int64_t) elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000;
+
+	if (code == source->last_press_code && ms >= 0 &&
+	        ms < keys_device->settings.debounceWindow)
+	{
+		set_key_bit(source->keys_bounced, code);
+		keys_device->stats.bounces++;
+		return true;
+	}
+
+	set_key_bit(source->keys_down, code);
+	source->last_press_code = code;
+	source->last_press_time = event_ptr->time;
+
+	return false;
+}
+
+static int64_t
+monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * Tracks the key to repeat from the presses and releases going into the
+ * ring. The last key pressed repeats, until it is released.
+ */
+static void
+track_repeat(keys_device_t *keys_device, keys_source_t *source,
+             const InputEvent_t *event_ptr)
+{
+	const keys_settings_t *settings = &keys_device->settings;
+	int delay = settings->repeatDelay;
+	int interval = settings->repeatInterval;
+
+	if (event_ptr->value == 0)
+	{
+		if (event_ptr->code == keys_device->repeat_code &&
+		        source == keys_device->repeat_source)
+		{
+			keys_device->repeat_code = -1;
+		}
+
+		return;
+	}
+
+	if (event_ptr->code >= KEY_CNT)
+	{
+		return;
+	}
+
+	/* a modifier is held with the key that repeats, it doesn't take over */
+	if (modifier_key_bit(keys_device, event_ptr->code) != 0 ||
+	        event_ptr->code == KEY_CAPSLOCK)
+	{
+		return;
+	}
+
+	if (keys_device->keymap[event_ptr->code].type == NYX_KEY_TYPE_CUSTOM)
+	{
+		delay = settings->customRepeatDelay;
+		interval = settings->customRepeatInterval;
+	}
+
+	keys_device->repeat_code = -1;
+
+	if (interval > 0)
+	{
+		keys_device->repeat_code = event_ptr->code;
+		keys_device->repeat_source = source;
+		keys_device->repeat_interval = interval;
+		keys_device->repeat_deadline = monotonic_ms() + delay;
+	}
+}
+
+static bool
+key_in_set(const keys_device_t *keys_device, uint16_t code, uint32_t keys)
+{
+	const keymap_entry_t *entry;
+
+	if (code >= KEY_CNT)
+	{
+		return false;
+	}
+
+	entry = &keys_device->keymap[code];
+
+	return entry->type == NYX_KEY_TYPE_CUSTOM && entry->key >= 0 &&
+	       entry->key < 32 && (keys & 1u << entry->key);
+}
+
+/*
+ * Tells whether a key event goes to the priority ring: a press of a key of
+ * Priority/Keys while the ring has room for it and its release, and the
+ * repeats and release of a key pressed in it, so that they are never
+ * delivered ahead of the press. The release always has its slot.
+ */
+static bool
+priority_takes(keys_device_t *keys_device, uint16_t code, int32_t value,
+               uint16_t press)
+{
+	unsigned int used = keys_device->priority_tail - keys_device->priority_head +
+	                    keys_device->priority_owed;
+
+	if (code >= KEY_CNT)
+	{
+		return false;
+	}
+
+	if (test_key_bit(keys_device->priority_held[press], code))
+	{
+		return value == 0 || used < KEYS_PRIORITY_RING_SIZE;
+	}
+
+	return value == 1 && used + 2 <= KEYS_PRIORITY_RING_SIZE &&
+	       key_in_set(keys_device, code, keys_device->settings.priorityKeys);
+}
+
+/*
+ * Queues a key event, in the priority ring if priority_takes() says so.
+ * Repeats of a key pressed in the priority ring that find it full are
+ * dropped rather than delivered after its release.
+ */
+static bool
+ring_push(keys_device_t *keys_device, const struct timeval *time,
+          uint16_t code, int32_t value, uint16_t press)
+{
+	key_input_t *input_ptr;
+
+	if (priority_takes(keys_device, code, value, press))
+	{
+		if (value == 0)
+		{
+			clear_key_bit(keys_device->priority_held[press], code);
+			keys_device->priority_owed--;
+		}
+		else if (value == 1 && !test_key_bit(keys_device->priority_held[press], code))
+		{
+			set_key_bit(keys_device->priority_held[press], code);
+			keys_device->priority_owed++;
+		}
+
+		input_ptr = &keys_device->priority_ring[keys_device->priority_tail++ &
+		                                        (KEYS_PRIORITY_RING_SIZE - 1)];
+	}
+	else if (code < KEY_CNT && value != 0 &&
+	         test_key_bit(keys_device->priority_held[press], code))
+	{
+		return false;
+	}
+	else if (keys_device->ring_tail - keys_device->ring_head < KEYS_RING_SIZE)
+	{
+		input_ptr = &keys_device->ring[keys_device->ring_tail++ & (KEYS_RING_SIZE - 1)];
+	}
+	else
+	{
+		return false;
+	}
+
+	input_ptr->time = *time;
+	input_ptr->code = code;
+	input_ptr->value = value;
+	input_ptr->press = press;
+
+	return true;
+}
+
+static int64_t
+timeval_ms(const struct timeval *time)
+{
+	return (int64_t) time->tv_sec * 1000 + time->tv_usec / 1000;
+}
+
+static void
+monotonic_timeval(int64_t ms, struct timeval *time)
+{
+	time->tv_sec = ms / 1000;
+	time->tv_usec = (ms % 1000) * 1000;
+}
+
+/*
+ * Stops tracking the key pressed last, releasing its long press if that was
+ * reported.
+ */
+static void
+end_press(keys_device_t *keys_device, const struct timeval *time)
+{
+	if (keys_device->press_held && keys_device->press_long)
+	{
+		(void)ring_push(keys_device, time, keys_device->press_code, 0,
+		                KEYS_PRESS_LONG);
+	}
+
+	keys_device->press_code = -1;
+	keys_device->press_held = false;
+}
+
+/*
+ * Tracks presses and releases of the keys of [LongPress] and [MultiPress]
+ * going into the ring. A press that follows the release of the same key
+ * within Press/MultiPress is followed by a multi press; the release of a
+ * long press by the release of the long press. The events that are added
+ * are lost if the ring is full.
+ *
+ * Multi presses go by the time stamps of the kernel, so presses read late
+ * in one go aren't taken for one. The long press is timed from when the
+ * press is read.
+ */
+static void
+track_press(keys_device_t *keys_device, keys_source_t *source,
+            const InputEvent_t *event_ptr)
+{
+	const keys_settings_t *settings = &keys_device->settings;
+	bool longPress = settings->longPress > 0 &&
+	                 keymap_find_press(&keys_device->long_presses, event_ptr->code);
+	bool multiPress = settings->multiPress > 0 &&
+	                  keymap_find_press(&keys_device->multi_presses, event_ptr->code);
+	int64_t elapsed;
+
+	if ((!longPress && !multiPress) || event_ptr->value > 1)
+	{
+		return;
+	}
+
+	if (event_ptr->value == 0)
+	{
+		if (event_ptr->code == keys_device->press_code && keys_device->press_held)
+		{
+			end_press(keys_device, &event_ptr->time);
+			keys_device->press_code = event_ptr->code;
+			keys_device->press_released = timeval_ms(&event_ptr->time);
+		}
+
+		return;
+	}
+
+	elapsed = timeval_ms(&event_ptr->time) - keys_device->press_released;
+
+	if (multiPress && event_ptr->code == keys_device->press_code &&
+	        !keys_device->press_held && elapsed >= 0 && elapsed < settings->multiPress)
+	{
+		keys_device->press_count++;
+	}
+	else
+	{
+		end_press(keys_device, &event_ptr->time);
+		keys_device->press_count = 1;
+	}
+
+	keys_device->press_code = event_ptr->code;
+	keys_device->press_source = source;
+	keys_device->press_held = true;
+	keys_device->press_long = false;
+	keys_device->press_deadline = longPress ? monotonic_ms() + settings->longPress :
+	                              INT64_MAX;
+
+	if (keys_device->press_count > 1)
+	{
+		(void)(ring_push(keys_device, &event_ptr->time, event_ptr->code, 1,
+		                 KEYS_PRESS_MULTI) &&
+		       ring_push(keys_device, &event_ptr->time, event_ptr->code, 0,
+		                 KEYS_PRESS_MULTI));
+	}
+}
+
+/*
+ * Moves a key event read from a keyboard to the ring, unless it is dropped.
+ */
+static void
+queue_input_event(keys_device_t *keys_device, keys_source_t *source,
+                  const InputEvent_t *event_ptr)
+{
+	if (debounce(keys_device, source, event_ptr))
+	{
+		return;
+	}
+
+	if (keys_device->settings.softwareRepeat)
+	{
+		/* in case the kernel still repeats */
+		if (event_ptr->value > 1)
+		{
+			return;
+		}
+
+		track_repeat(keys_device, source, event_ptr);
+	}
+
+	(void)ring_push(keys_device, &event_ptr->time, event_ptr->code,
+	                event_ptr->value, 0);
+	track_press(keys_device, source, event_ptr);
+}
+
+/*
+ * With the ring full, moves the priority keys read from the keyboards
+ * already to the priority ring, ahead of the events of the other keyboards
+ * and of the ring. Only those at the front of a keyboard's buffer are taken,
+ * so that its events still go through debounce() and track_press() in the
+ * order they were read.
+ */
+static void
+pull_priority_events(keys_device_t *keys_device)
+{
+	int i;
+
+	for (i = 0; i < keys_device->num_sources; i++)
+	{
+		keys_source_t *source = &keys_device->sources[i];
+		InputEvent_t *event_ptr;
+
+		while (NULL != (event_ptr = source_peek(source)) &&
+		        priority_takes(keys_device, event_ptr->code, event_ptr->value, 0))
+		{
+			source->event_iter++;
+			queue_input_event(keys_device, source, event_ptr);
+		}
+	}
+}
+
+/*
+ * Reads everything the keyboards have buffered, or as much as fits into the
+ * ring, and moves their key events to the ring oldest first.
+ */
+static void
+drain_input_events(keys_device_t *keys_device)
+{
+	int i;
+
+	for (i = 0; i < keys_device->num_sources; i++)
+	{
+		keys_device->sources[i].drained = false;
+	}
+
+	while (keys_device->ring_tail - keys_device->ring_head < KEYS_RING_SIZE)
+	{
+		keys_source_t *next_source = NULL;
+		InputEvent_t *next_event = NULL;
+		for (i = 0; i < keys_device->num_sources; i++)
+		{
+			InputEvent_t *event_ptr = source_peek(&keys_device->sources[i]);
+
+			if (NULL != event_ptr && (NULL == next_event ||
+			                          timercmp(&event_ptr->time, &next_event->time, <)))
+			{
+				next_source = &keys_device->sources[i];
+				next_event = event_ptr;
+			}
+		}
+
+		if (NULL == next_event)
+		{
+			break;
+		}
+
+		next_source->event_iter++;
+		queue_input_event(keys_device, next_source, next_event);
+	}
+
+	if (keys_device->ring_tail - keys_device->ring_head >= KEYS_RING_SIZE)
+	{
+		pull_priority_events(keys_device);
+	}
+
+	/* the keyboard went away with the key held down */
+	if (keys_device->repeat_code >= 0 && keys_device->repeat_source->fd < 0)
+	{
+		keys_device->repeat_code = -1;
+	}
+
+	if (keys_device->press_held && keys_device->press_source->fd < 0)
+	{
+		struct timeval now;
+
+		monotonic_timeval(monotonic_ms(), &now);
+		end_press(keys_device, &now);
+	}
+}
+
+/*
+ * Queues the repeats of the held key that are due. Repeats missed while
+ * nobody read the device are dropped rather than delivered in a burst: no
+ * more than Repeat/MaxQueued of them wait in the ring at any time.
+ */
+static void
+queue_repeats(keys_device_t *keys_device)
+{
+	int64_t now = monotonic_ms();
+	struct timeval time;
+	int64_t due;
+
+	if (keys_device->repeat_code < 0 || now < keys_device->repeat_deadline)
+	{
+		return;
+	}
+
+	due = 1 + (now - keys_device->repeat_deadline) / keys_device->repeat_interval;
+	keys_device->repeat_deadline += due * keys_device->repeat_interval;
+
+	monotonic_timeval(now, &time);
+
+	while (due-- > 0 &&
+	        keys_device->queued_repeats < keys_device->settings.maxQueuedRepeats &&
+	        ring_push(keys_device, &time, keys_device->repeat_code, 2, 0))
+	{
+		keys_device->queued_repeats++;
+	}
+}
+
+/*
+ * Queues the long press of the key held down once it is due, and after
+ * that a repeat of the long press every Press/Hold.
+ */
+static void
+queue_long_press(keys_device_t *keys_device)
+{
+	int64_t now = monotonic_ms();
+	struct timeval time;
+
+	if (!keys_device->press_held || now < keys_device->press_deadline)
+	{
+		return;
+	}
+
+	monotonic_timeval(now, &time);
+
+	if (!keys_device->press_long)
+	{
+		keys_device->press_long = ring_push(keys_device, &time,
+		                                    keys_device->press_code, 1, KEYS_PRESS_LONG);
+	}
+	else
+	{
+		(void)ring_push(keys_device, &time, keys_device->press_code, 2,
+		                KEYS_PRESS_LONG);
+	}
+
+	/* after falling behind, the next hold is a whole interval away */
+	keys_device->press_deadline += keys_device->settings.holdInterval;
+
+	if (keys_device->press_deadline <= now)
+	{
+		keys_device->press_deadline = now + keys_device->settings.holdInterval;
+	}
+}
+
+/*
+ * Returns the ms of CLOCK_MONOTONIC the next repeat or long press is due,
+ * INT64_MAX if none is.
+ */
+static int64_t
+next_deadline(keys_device_t *keys_device)
+{
+	const keys_settings_t *settings = &keys_device->settings;
+	int64_t deadline = INT64_MAX;
+
+	if (keys_device->repeat_code >= 0)
+	{
+		deadline = keys_device->repeat_deadline;
+	}
+
+	if (keys_device->press_held &&
+	        (keys_device->press_long ? settings->holdInterval : settings->longPress) > 0)
+	{
+		deadline = MIN(deadline, keys_device->press_deadline);
+	}
+
+	return deadline;
+}
+
+static void
+count_latency(keys_latency_t *latency, const key_input_t *input_ptr,
+              const struct timespec *now)
+{
+	int64_t us = ((int64_t) now->tv_sec - input_ptr->time.tv_sec) * 1000000 +
+	             now->tv_nsec / 1000 - input_ptr->time.tv_usec;
+
+	if (us < 0 || us >= KEYS_MAX_LATENCY_US)
+	{
+		return;
+	}
+
+	latency->count++;
+	latency->total_us += us;
+	latency->max_us = MAX(latency->max_us, (uint32_t) us);
+}
+
+nyx_error_t keys_get_event(nyx_device_t *d, nyx_event_t **e)
+{
+	keys_device_t *keys_device = (keys_device_t *) d;
+	key_input_t *input_ptr;
+	nyx_event_keys_t *event_ptr;
+	struct timespec now;
+	bool priority;
+
+	*e = NULL;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/*
+	 * Catch the release of the held key before repeating it or reporting a
+	 * long press, it may be waiting behind the events already in the ring.
+	 */
+	if ((int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 >=
+	        next_deadline(keys_device))
+	{
+		drain_input_events(keys_device);
+		queue_repeats(keys_device);
+		queue_long_press(keys_device);
+	}
+
+	/*
+	 * A priority key may be waiting behind the events in the ring, or while
+	 * the caller holds on to the events for the others.
+	 */
+	if (keys_device->ring_head == keys_device->ring_tail ||
+	        (keys_device->ring_head & (KEYS_PRIORITY_POLL - 1)) == 0 ||
+	        keys_device->num_free_events <= KEYS_PRIORITY_RESERVED)
+	{
+		drain_input_events(keys_device);
+	}
+
+	priority = keys_device->priority_head != keys_device->priority_tail;
+
+	if (!priority && keys_device->ring_head == keys_device->ring_tail)
+	{
+		update_event_source(keys_device);
+		return NYX_ERROR_NONE;
+	}
+
+	/*
+	 * The caller still holds every event of the pool. Keep the input until
+	 * it releases some, keys_release_event() signals the event source again.
+	 */
+	event_ptr = keys_event_create(keys_device, priority);
+
+	if (NULL == event_ptr)
+	{
+		nyx_debug("Out of key events, %u left to deliver",
+		          keys_device->ring_tail - keys_device->ring_head);
+		update_event_source(keys_device);
+		return NYX_ERROR_NONE;
+	}
+
+	if (priority)
+	{
+		input_ptr = &keys_device->priority_ring[keys_device->priority_head++ &
+		                                        (KEYS_PRIORITY_RING_SIZE - 1)];
+		count_latency(&keys_device->stats.priority, input_ptr, &now);
+	}
+	else
+	{
+		input_ptr = &keys_device->ring[keys_device->ring_head++ & (KEYS_RING_SIZE - 1)];
+		count_latency(&keys_device->stats.standard, input_ptr, &now);
+	}
+
+	if (input_ptr->value > 1 && input_ptr->press == 0 &&
+	        keys_device->settings.softwareRepeat)
+	{
+		keys_device->queued_repeats--;
+	}
+
+	decode_key(keys_device, input_ptr, event_ptr);
+	event_ptr->key_is_press = (input_ptr->value) ? true : false;
+	event_ptr->key_is_auto_repeat = (input_ptr->value > 1) ? true : false;
+
+	*e = (nyx_event_t *) event_ptr;
+	update_event_source(keys_device);
+
+	return NYX_ERROR_NONE;
+}
+
+/*
+ * Bulk version of keys_get_event(): fills events with up to maxEvents events
+ * and stops early once the device has no more input. Every event must be
+ * released with keys_release_event().
+ *
+ * Registered as NYX_GET_EVENTS_MODULE_METHOD with versions of nyx-lib that
+ * have it.
+ */
+nyx_error_t keys_get_events(nyx_device_t *d, nyx_event_t **events,
+                            int maxEvents, int *numEvents)
+{
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == events || NULL == numEvents || maxEvents < 0)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	*numEvents = 0;
+
+	/*
+	 * keys_get_event() drains the device whenever it runs out of events, so
+	 * it only comes back empty handed once there is nothing left to deliver.
+	 */
+	while (*numEvents < maxEvents)
+	{
+		nyx_event_t *event = NULL;
+
+		keys_get_event(d, &event);
+
+		if (NULL == event)
+		{
+			break;
+		}
+
+		events[(*numEvents)++] = event;
+	}
+
+	return NYX_ERROR_NONE;
+}
+
+/*
+ * Returns the modifiers (KEYS_MODIFIER_*) held down as of the last event
+ * returned by keys_get_event(). nyx-lib has no module method for this, see
+ * keys.h.
+ */
+nyx_error_t keys_get_modifiers(nyx_device_t *d, uint32_t *modifiers)
+{
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == modifiers)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	*modifiers = current_modifiers((keys_device_t *) d);
+
 	return NYX_ERROR_NONE;
 }
 
+/*
+ * Tells whether an event returned by keys_get_event() is a key of
+ * Priority/Keys, to be handled right away.
+ */
+bool keys_event_is_priority(nyx_device_t *d, nyx_event_t *e)
+{
+	keys_device_t *keys_device = (keys_device_t *) d;
+	int slot;
+
+	if (NULL == d)
+	{
+		return false;
+	}
+
+	slot = keys_event_slot(keys_device, e);
+
+	return slot >= 0 && keys_device->event_in_use[slot] &&
+	       keys_device->event_is_priority[slot];
+}
+
+/*
+ * Returns the latencies of the keys delivered so far, those of Priority/Keys
+ * and those of all other keys apart.
+ */
+nyx_error_t keys_get_stats(nyx_device_t *d, keys_stats_t *stats)
+{
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == stats)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	*stats = ((keys_device_t *) d)->stats;
+
+	return NYX_ERROR_NONE;
+}
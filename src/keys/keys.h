@@ -0,0 +1,55 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Methods of the keys module beyond those of every nyx keys module.
+ * keys_get_events() is registered as NYX_GET_EVENTS_MODULE_METHOD with
+ * versions of nyx-lib that have it, the others are called directly.
+ */
+
+#ifndef __KEYS_H
+#define __KEYS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nyx/nyx_module.h>
+
+/** time from the kernel reporting a key event to its delivery */
+typedef struct keys_latency
+{
+	uint32_t count;         /**< events delivered */
+	uint64_t total_us;
+	uint32_t max_us;
+} keys_latency_t;
+
+typedef struct keys_stats
+{
+	keys_latency_t priority;    /**< keys of Priority/Keys */
+	keys_latency_t standard;    /**< all other keys */
+	uint32_t bounces;           /**< presses dropped by [Debounce], with their
+                                     releases */
+	uint32_t duplicates;        /**< presses of held keys and releases of
+                                     released keys dropped by [Debounce] */
+} keys_stats_t;
+
+nyx_error_t keys_get_events(nyx_device_t *d, nyx_event_t **events,
+                            int maxEvents, int *numEvents);
+nyx_error_t keys_get_modifiers(nyx_device_t *d, uint32_t *modifiers);
+bool keys_event_is_priority(nyx_device_t *d, nyx_event_t *e);
+nyx_error_t keys_get_stats(nyx_device_t *d, keys_stats_t *stats);
+
+#endif  /* __KEYS_H */
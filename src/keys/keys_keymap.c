@@ -0,0 +1,390 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include <nyx/module/nyx_log.h>
+
+#include "keys_keymap.h"
+#include "msgid.h"
+
+typedef struct
+{
+	const char *name;
+	keymap_entry_t entry;
+} keymap_name_t;
+
+/* names the keymap file may use for the keys reported to nyx */
+static const keymap_name_t sKeyNames[] =
+{
+	{ "Home", { NYX_KEYS_CUSTOM_KEY_HOME, NYX_KEY_TYPE_CUSTOM } },
+	{ "Hot", { NYX_KEYS_CUSTOM_KEY_HOT, NYX_KEY_TYPE_CUSTOM } },
+	{ "Back", { NYX_KEYS_CUSTOM_KEY_BACK, NYX_KEY_TYPE_CUSTOM } },
+	{ "VolumeUp", { NYX_KEYS_CUSTOM_KEY_VOL_UP, NYX_KEY_TYPE_CUSTOM } },
+	{ "VolumeDown", { NYX_KEYS_CUSTOM_KEY_VOL_DOWN, NYX_KEY_TYPE_CUSTOM } },
+	{ "VolumeMute", { NYX_KEYS_CUSTOM_KEY_VOL_MUTE, NYX_KEY_TYPE_CUSTOM } },
+	{ "PowerOn", { NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaPlay", { NYX_KEYS_CUSTOM_KEY_MEDIA_PLAY, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaPause", { NYX_KEYS_CUSTOM_KEY_MEDIA_PAUSE, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaStop", { NYX_KEYS_CUSTOM_KEY_MEDIA_STOP, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaNext", { NYX_KEYS_CUSTOM_KEY_MEDIA_NEXT, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaPrevious", { NYX_KEYS_CUSTOM_KEY_MEDIA_PREVIOUS, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaRewind", { NYX_KEYS_CUSTOM_KEY_MEDIA_REWIND, NYX_KEY_TYPE_CUSTOM } },
+	{ "MediaFastForward", { NYX_KEYS_CUSTOM_KEY_MEDIA_FASTFORWARD, NYX_KEY_TYPE_CUSTOM } },
+	{ "Search", { NYX_KEYS_CUSTOM_KEY_SEARCH, NYX_KEY_TYPE_CUSTOM } },
+	{ "BrightnessUp", { NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_UP, NYX_KEY_TYPE_CUSTOM } },
+	{ "BrightnessDown", { NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_DOWN, NYX_KEY_TYPE_CUSTOM } },
+	{ "F1", { F1, NYX_KEY_TYPE_STANDARD } },
+	{ "F2", { F2, NYX_KEY_TYPE_STANDARD } },
+	{ "F3", { F3, NYX_KEY_TYPE_STANDARD } },
+	{ "F4", { F4, NYX_KEY_TYPE_STANDARD } },
+	{ "F5", { F5, NYX_KEY_TYPE_STANDARD } },
+	{ "F6", { F6, NYX_KEY_TYPE_STANDARD } },
+	{ "F7", { F7, NYX_KEY_TYPE_STANDARD } },
+	{ "F8", { F8, NYX_KEY_TYPE_STANDARD } },
+	{ "F9", { F9, NYX_KEY_TYPE_STANDARD } },
+	{ "F10", { F10, NYX_KEY_TYPE_STANDARD } },
+	{ "Sym", { KEY_SYM, NYX_KEY_TYPE_STANDARD } },
+	{ "Orange", { KEY_ORANGE, NYX_KEY_TYPE_STANDARD } },
+};
+
+/* built-in keymap, every code not listed is reported as it is */
+static const struct
+{
+	uint16_t code;
+	int32_t key;
+} sDefaultKeymap[] =
+{
+	{ KEY_Q, NYX_KEYS_CUSTOM_KEY_HOME },
+	{ KEY_HOME, NYX_KEYS_CUSTOM_KEY_HOME },
+	{ KEY_W, NYX_KEYS_CUSTOM_KEY_HOT },
+	{ KEY_HOMEPAGE, NYX_KEYS_CUSTOM_KEY_HOT },
+	{ KEY_E, NYX_KEYS_CUSTOM_KEY_BACK },
+	{ KEY_BACK, NYX_KEYS_CUSTOM_KEY_BACK },
+	{ KEY_VOLUMEUP, NYX_KEYS_CUSTOM_KEY_VOL_UP },
+	{ KEY_VOLUMEDOWN, NYX_KEYS_CUSTOM_KEY_VOL_DOWN },
+	{ KEY_MUTE, NYX_KEYS_CUSTOM_KEY_VOL_MUTE },
+	{ KEY_END, NYX_KEYS_CUSTOM_KEY_POWER_ON },
+	{ KEY_POWER, NYX_KEYS_CUSTOM_KEY_POWER_ON },
+	{ KEY_PLAY, NYX_KEYS_CUSTOM_KEY_MEDIA_PLAY },
+	{ KEY_PAUSE, NYX_KEYS_CUSTOM_KEY_MEDIA_PAUSE },
+	{ KEY_STOP, NYX_KEYS_CUSTOM_KEY_MEDIA_STOP },
+	{ KEY_NEXT, NYX_KEYS_CUSTOM_KEY_MEDIA_NEXT },
+	{ KEY_PREVIOUS, NYX_KEYS_CUSTOM_KEY_MEDIA_PREVIOUS },
+	{ KEY_REWIND, NYX_KEYS_CUSTOM_KEY_MEDIA_REWIND },
+	{ KEY_FASTFORWARD, NYX_KEYS_CUSTOM_KEY_MEDIA_FASTFORWARD },
+	{ KEY_SEARCH, NYX_KEYS_CUSTOM_KEY_SEARCH },
+	{ KEY_BRIGHTNESSDOWN, NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_DOWN },
+	{ KEY_BRIGHTNESSUP, NYX_KEYS_CUSTOM_KEY_BRIGHTNESS_UP },
+};
+
+void
+keymap_init_defaults(keymap_t keymap)
+{
+	size_t i;
+
+	for (i = 0; i < KEY_CNT; i++)
+	{
+		keymap[i].key = i;
+		keymap[i].type = NYX_KEY_TYPE_STANDARD;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(sDefaultKeymap); i++)
+	{
+		keymap[sDefaultKeymap[i].code].key = sDefaultKeymap[i].key;
+		keymap[sDefaultKeymap[i].code].type = NYX_KEY_TYPE_CUSTOM;
+	}
+}
+
+/*
+ * Parses a number the way the keymap file writes them, decimal or 0x hex.
+ */
+static bool
+parse_number(const char *pStr, long *pValue)
+{
+	char *end;
+
+	errno = 0;
+	*pValue = strtol(pStr, &end, 0);
+
+	return errno == 0 && end != pStr && *end == '\0';
+}
+
+static bool
+parse_key(const char *pStr, keymap_entry_t *pEntry)
+{
+	long value;
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(sKeyNames); i++)
+	{
+		if (strcmp(pStr, sKeyNames[i].name) == 0)
+		{
+			*pEntry = sKeyNames[i].entry;
+			return true;
+		}
+	}
+
+	if (!parse_number(pStr, &value) || value < 0 || value > INT32_MAX)
+	{
+		return false;
+	}
+
+	pEntry->key = value;
+	pEntry->type = NYX_KEY_TYPE_STANDARD;
+
+	return true;
+}
+
+/*
+ * Looks up a key the way the keymap file writes them, for the other files
+ * of the module.
+ */
+bool
+keymap_parse_key(const char *pStr, keymap_entry_t *pEntry)
+{
+	return parse_key(pStr, pEntry);
+}
+
+static const struct
+{
+	const char *name;
+	uint32_t modifier;
+} sModifierNames[] =
+{
+	{ "Shift", KEYS_MODIFIER_SHIFT },
+	{ "Ctrl", KEYS_MODIFIER_CTRL },
+	{ "Alt", KEYS_MODIFIER_ALT },
+	{ "Meta", KEYS_MODIFIER_META },
+	{ "Sym", KEYS_MODIFIER_SYM },
+	{ "Orange", KEYS_MODIFIER_ORANGE },
+};
+
+/*
+ * Parses the key of a [Chords] entry, modifier names and an evdev key code
+ * joined by '+', e.g. Orange+103.
+ */
+static bool
+parse_chord(const char *pStr, keymap_chord_t *pChord)
+{
+	gchar **parts = g_strsplit(pStr, "+", -1);
+	guint numParts = g_strv_length(parts);
+	bool valid = numParts >= 2;
+	long code;
+	guint i;
+	size_t j;
+
+	pChord->modifiers = 0;
+
+	for (i = 0; valid && i + 1 < numParts; i++)
+	{
+		for (j = 0; j < G_N_ELEMENTS(sModifierNames); j++)
+		{
+			if (strcmp(parts[i], sModifierNames[j].name) == 0)
+			{
+				pChord->modifiers |= sModifierNames[j].modifier;
+				break;
+			}
+		}
+
+		valid = j < G_N_ELEMENTS(sModifierNames);
+	}
+
+	valid = valid && parse_number(parts[numParts - 1], &code) && code >= 0 &&
+	        code < KEY_CNT;
+	pChord->code = valid ? code : 0;
+
+	g_strfreev(parts);
+	return valid;
+}
+
+/*
+ * Returns what a long or multi press of the key is reported as, NULL if it
+ * isn't in pPresses.
+ */
+const keymap_entry_t *
+keymap_find_press(const keymap_presses_t *pPresses, uint16_t code)
+{
+	int i;
+
+	for (i = 0; i < pPresses->num_presses; i++)
+	{
+		if (pPresses->presses[i].code == code)
+		{
+			return &pPresses->presses[i].entry;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Reads a [LongPress] or [MultiPress] group into pPresses. Returns false if
+ * an entry is invalid.
+ */
+static bool
+load_presses(GKeyFile *keyFile, const char *pPath, const char *pGroup,
+             keymap_presses_t *pPresses)
+{
+	gchar **codes = g_key_file_get_keys(keyFile, pGroup, NULL, NULL);
+	bool valid = true;
+	size_t i;
+
+	for (i = 0; valid && codes && codes[i]; i++)
+	{
+		keymap_press_t *pPress = &pPresses->presses[pPresses->num_presses];
+		gchar *value = g_key_file_get_string(keyFile, pGroup, codes[i], NULL);
+		long code;
+
+		valid = pPresses->num_presses < KEYMAP_MAX_PRESSES &&
+		        parse_number(codes[i], &code) && code >= 0 && code < KEY_CNT &&
+		        value && parse_key(value, &pPress->entry);
+
+		if (!valid)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_KEYMAP_ERR, 0, "%s: invalid %s entry %s=%s",
+			          pPath, pGroup, codes[i], value ? value : "");
+		}
+		else
+		{
+			pPress->code = code;
+			pPresses->num_presses++;
+		}
+
+		g_free(value);
+	}
+
+	g_strfreev(codes);
+	return valid;
+}
+
+/**
+ *******************************************************************************
+ * @brief Override keymap entries with the ones found in a keymap file
+ *
+ * Every key of the [Keymap] group is an evdev key code, its value either one
+ * of the names in sKeyNames or the code of a standard key. Codes that are
+ * missing keep their current entry.
+ *
+ * Every key of the [Chords] group is a chord, see parse_chord(), its value
+ * what the chord is reported as, like in [Keymap]. The chords found replace
+ * pChords.
+ *
+ * Every key of the [LongPress] and [MultiPress] groups is an evdev key code,
+ * its value what a long or a multi press of the key is reported as, like in
+ * [Keymap]. The entries found replace pLongPresses and pMultiPresses.
+ *
+ * If any entry is invalid nothing is changed.
+ *
+ * @param  pPath        IN      path of the keymap file
+ * @param  keymap       IN/OUT  keymap to update
+ * @param  pChords      IN/OUT  chords to update
+ * @param  pLongPresses IN/OUT  long presses to update
+ * @param  pMultiPresses IN/OUT multi presses to update
+ *
+ * @retval  0 on success
+ * @retval -1 on failure
+ *******************************************************************************
+ */
+int
+keymap_load(const char *pPath, keymap_t keymap, keymap_chords_t *pChords,
+            keymap_presses_t *pLongPresses, keymap_presses_t *pMultiPresses)
+{
+	keymap_entry_t *pUpdated = g_new(keymap_entry_t, KEY_CNT);
+	keymap_chords_t *pUpdatedChords = g_new0(keymap_chords_t, 1);
+	keymap_presses_t *pUpdatedPresses = g_new0(keymap_presses_t, 2);
+	GKeyFile *keyFile = g_key_file_new();
+	GError *error = NULL;
+	gchar **codes = NULL;
+	int ret = -1;
+	size_t i;
+
+	memcpy(pUpdated, keymap, sizeof(keymap_t));
+
+	if (!g_key_file_load_from_file(keyFile, pPath, G_KEY_FILE_NONE, &error))
+	{
+		nyx_error(MSGID_NYX_QMUX_KEYS_KEYMAP_ERR, 0, "Failed to load %s: %s",
+		          pPath, error->message);
+		goto exit;
+	}
+
+	codes = g_key_file_get_keys(keyFile, "Keymap", NULL, NULL);
+
+	for (i = 0; codes && codes[i]; i++)
+	{
+		gchar *value = g_key_file_get_string(keyFile, "Keymap", codes[i], NULL);
+		long code;
+		bool valid = parse_number(codes[i], &code) && code >= 0 && code < KEY_CNT &&
+		             value && parse_key(value, &pUpdated[code]);
+
+		if (!valid)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_KEYMAP_ERR, 0, "%s: invalid entry %s=%s",
+			          pPath, codes[i], value ? value : "");
+			g_free(value);
+			goto exit;
+		}
+
+		g_free(value);
+	}
+
+	g_strfreev(codes);
+	codes = g_key_file_get_keys(keyFile, "Chords", NULL, NULL);
+
+	for (i = 0; codes && codes[i]; i++)
+	{
+		keymap_chord_t *pChord = &pUpdatedChords->chords[pUpdatedChords->num_chords];
+		gchar *value = g_key_file_get_string(keyFile, "Chords", codes[i], NULL);
+		bool valid = pUpdatedChords->num_chords < KEYMAP_MAX_CHORDS &&
+		             parse_chord(codes[i], pChord) &&
+		             value && parse_key(value, &pChord->entry);
+
+		if (!valid)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_KEYMAP_ERR, 0, "%s: invalid chord %s=%s",
+			          pPath, codes[i], value ? value : "");
+			g_free(value);
+			goto exit;
+		}
+
+		pUpdatedChords->num_chords++;
+		g_free(value);
+	}
+
+	if (!load_presses(keyFile, pPath, "LongPress", &pUpdatedPresses[0]) ||
+	        !load_presses(keyFile, pPath, "MultiPress", &pUpdatedPresses[1]))
+	{
+		goto exit;
+	}
+
+	memcpy(keymap, pUpdated, sizeof(keymap_t));
+	*pChords = *pUpdatedChords;
+	*pLongPresses = pUpdatedPresses[0];
+	*pMultiPresses = pUpdatedPresses[1];
+	ret = 0;
+
+exit:
+	g_strfreev(codes);
+	g_clear_error(&error);
+	g_key_file_free(keyFile);
+	g_free(pUpdatedPresses);
+	g_free(pUpdatedChords);
+	g_free(pUpdated);
+	return ret;
+}
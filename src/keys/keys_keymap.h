@@ -0,0 +1,101 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __KEYS_KEYMAP_H
+#define __KEYS_KEYMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#include <nyx/nyx_module.h>
+
+/* nyx codes of keys that evdev has no code for */
+enum
+{
+	F1 = 0x276C, /* Function keys */
+	F2 = 0x276D,
+	F3 = 0x276E,
+	F4 = 0x276F,
+	F5 = 0x2770,
+	F6 = 0x2771,
+	F7 = 0x2772,
+	F8 = 0x2773,
+	F9 = 0x2774,
+	F10 = 0x2775,
+	KEY_SYM = 0xf6,
+	KEY_ORANGE = 0x64
+};
+
+typedef struct keymap_entry
+{
+	int32_t key;            /**< key reported to nyx */
+	nyx_key_type_t type;    /**< standard or custom key */
+} keymap_entry_t;
+
+/** what each evdev key code is reported as, indexed by the code */
+typedef keymap_entry_t keymap_t[KEY_CNT];
+
+/* modifiers held down, as a bitmask */
+enum
+{
+	KEYS_MODIFIER_SHIFT = 1 << 0,
+	KEYS_MODIFIER_CTRL = 1 << 1,
+	KEYS_MODIFIER_ALT = 1 << 2,
+	KEYS_MODIFIER_META = 1 << 3,
+	KEYS_MODIFIER_SYM = 1 << 4,
+	KEYS_MODIFIER_ORANGE = 1 << 5
+};
+
+#define KEYMAP_MAX_CHORDS   32
+
+/** a key pressed while exactly the given modifiers are held down */
+typedef struct keymap_chord
+{
+	uint32_t modifiers;     /**< KEYS_MODIFIER_* */
+	uint16_t code;          /**< evdev key code */
+	keymap_entry_t entry;   /**< key reported to nyx instead */
+} keymap_chord_t;
+
+typedef struct keymap_chords
+{
+	keymap_chord_t chords[KEYMAP_MAX_CHORDS];
+	int num_chords;
+} keymap_chords_t;
+
+#define KEYMAP_MAX_PRESSES  16
+
+/** a key held down long or pressed several times in a row */
+typedef struct keymap_press
+{
+	uint16_t code;          /**< evdev key code */
+	keymap_entry_t entry;   /**< key reported to nyx for the press */
+} keymap_press_t;
+
+typedef struct keymap_presses
+{
+	keymap_press_t presses[KEYMAP_MAX_PRESSES];
+	int num_presses;
+} keymap_presses_t;
+
+void keymap_init_defaults(keymap_t keymap);
+bool keymap_parse_key(const char *pStr, keymap_entry_t *pEntry);
+const keymap_entry_t *keymap_find_press(const keymap_presses_t *pPresses,
+                                        uint16_t code);
+int keymap_load(const char *pPath, keymap_t keymap, keymap_chords_t *pChords,
+                keymap_presses_t *pLongPresses, keymap_presses_t *pMultiPresses);
+
+#endif  /* __KEYS_KEYMAP_H */
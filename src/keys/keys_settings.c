@@ -0,0 +1,161 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <stddef.h>
+#include <glib.h>
+
+#include <nyx/module/nyx_log.h>
+
+#include "keys_keymap.h"
+#include "keys_settings.h"
+#include "msgid.h"
+
+typedef struct
+{
+	const char *group;
+	const char *key;
+	size_t offset;
+	int min;
+	int max;
+} setting_desc_t;
+
+#define SETTING(group, key, field, min, max) \
+  { group, key, offsetof(keys_settings_t, field), min, max }
+
+static const setting_desc_t sSettingDescs[] =
+{
+	SETTING("Repeat", "Software", softwareRepeat, 0, 1),
+	SETTING("Repeat", "Delay", repeatDelay, 1, 10000),
+	SETTING("Repeat", "Interval", repeatInterval, 0, 10000),
+	SETTING("Repeat", "CustomDelay", customRepeatDelay, 1, 10000),
+	SETTING("Repeat", "CustomInterval", customRepeatInterval, 0, 10000),
+	SETTING("Repeat", "MaxQueued", maxQueuedRepeats, 1, 256),
+	SETTING("Press", "LongPress", longPress, 0, 10000),
+	SETTING("Press", "Hold", holdInterval, 0, 10000),
+	SETTING("Press", "MultiPress", multiPress, 0, 10000),
+	SETTING("Debounce", "Window", debounceWindow, 0, 1000),
+};
+
+/*
+ * Parses group/Keys, a list of the custom keys of the keymap file.
+ */
+static bool
+load_key_list(GKeyFile *keyFile, const char *pPath, const char *pGroup,
+              uint32_t *pKeys)
+{
+	gchar **names = g_key_file_get_string_list(keyFile, pGroup, "Keys", NULL,
+	                NULL);
+	bool valid = names != NULL;
+	size_t i;
+
+	*pKeys = 0;
+
+	for (i = 0; valid && names[i]; i++)
+	{
+		keymap_entry_t entry;
+
+		valid = keymap_parse_key(g_strstrip(names[i]), &entry) &&
+		        entry.type == NYX_KEY_TYPE_CUSTOM && entry.key < 32;
+
+		if (!valid)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_SETTINGS_ERR, 0,
+			          "%s: %s/Keys: %s is not a custom key", pPath, pGroup, names[i]);
+		}
+		else
+		{
+			*pKeys |= 1u << entry.key;
+		}
+	}
+
+	g_strfreev(names);
+	return valid;
+}
+
+/**
+ *******************************************************************************
+ * @brief Override settings with the values found in a key file
+ *
+ * Keys that are missing keep their current value. If any key is invalid or
+ * out of range nothing is changed.
+ *
+ * @param  pPath        IN      path of the key file
+ * @param  pSettings    IN/OUT  settings to update
+ *
+ * @retval  0 on success
+ * @retval -1 on failure
+ *******************************************************************************
+ */
+int
+load_keys_settings(const char *pPath, keys_settings_t *pSettings)
+{
+	keys_settings_t settings = *pSettings;
+	GKeyFile *keyFile = g_key_file_new();
+	GError *error = NULL;
+	int ret = -1;
+	size_t i;
+
+	if (!g_key_file_load_from_file(keyFile, pPath, G_KEY_FILE_NONE, &error))
+	{
+		nyx_error(MSGID_NYX_QMUX_KEYS_SETTINGS_ERR, 0, "Failed to load %s: %s",
+		          pPath, error->message);
+		goto exit;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(sSettingDescs); i++)
+	{
+		const setting_desc_t *desc = &sSettingDescs[i];
+		int value;
+
+		if (!g_key_file_has_key(keyFile, desc->group, desc->key, NULL))
+		{
+			continue;
+		}
+
+		value = g_key_file_get_integer(keyFile, desc->group, desc->key, &error);
+
+		if (error)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_SETTINGS_ERR, 0, "%s: invalid %s/%s: %s",
+			          pPath, desc->group, desc->key, error->message);
+			goto exit;
+		}
+
+		if (value < desc->min || value > desc->max)
+		{
+			nyx_error(MSGID_NYX_QMUX_KEYS_SETTINGS_ERR, 0,
+			          "%s: %s/%s out of range (%d, expected %d..%d)",
+			          pPath, desc->group, desc->key, value, desc->min, desc->max);
+			goto exit;
+		}
+
+		*(int *)((char *)&settings + desc->offset) = value;
+	}
+
+	if (g_key_file_has_key(keyFile, "Priority", "Keys", NULL) &&
+	        !load_key_list(keyFile, pPath, "Priority", &settings.priorityKeys))
+	{
+		goto exit;
+	}
+
+	*pSettings = settings;
+	ret = 0;
+
+exit:
+	g_clear_error(&error);
+	g_key_file_free(keyFile);
+	return ret;
+}
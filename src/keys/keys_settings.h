@@ -0,0 +1,48 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __KEYS_SETTINGS_H
+#define __KEYS_SETTINGS_H
+
+#include <stdint.h>
+
+typedef struct keys_settings
+{
+	int softwareRepeat;         /**< 1 to repeat held keys in the module
+                                     instead of the kernel */
+	int repeatDelay;            /**< ms a standard key is held before it repeats */
+	int repeatInterval;         /**< ms between repeats of a standard key,
+                                     0 = no repeat */
+	int customRepeatDelay;      /**< ms a custom key is held before it repeats */
+	int customRepeatInterval;   /**< ms between repeats of a custom key,
+                                     0 = no repeat */
+	int maxQueuedRepeats;       /**< repeats that may wait for the caller,
+                                     later ones are dropped */
+	int longPress;              /**< ms a key is held for a long press,
+                                     0 = off */
+	int holdInterval;           /**< ms between hold events of a long press,
+                                     0 = off */
+	int multiPress;             /**< ms between the release of a key and the
+                                     next press of a multi press, 0 = off */
+	int debounceWindow;         /**< ms within which a press of the key pressed
+                                     last is dropped, 0 = off */
+	uint32_t priorityKeys;      /**< custom keys delivered ahead of the
+                                     others, one bit per key */
+} keys_settings_t;
+
+int load_keys_settings(const char *pPath, keys_settings_t *pSettings);
+
+#endif  /* __KEYS_SETTINGS_H */
@@ -0,0 +1,348 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Throughput benchmark for the keys module.
+//
+// Feeds key events through pipes standing in for the keyboards and reports
+// the time and the number of heap allocations per event it takes
+// keys_get_event() (or keys_get_events()) to deliver them.
+//
+// Usage: bench_keys [--json] [--events N]
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+nyx_error_t nyx_module_register_method(nyx_instance_t instance,
+                                       nyx_device_t *device_in_ptr,
+                                       module_method_t method,
+                                       const char *symbol_str)
+{
+	return NYX_ERROR_NONE;
+}
+
+// keep away from the keyboards and the files of the machine, like test_keys
+#undef KEYPAD_INPUT_DEVICE
+#undef KEYS_KEYMAP_FILE
+#define KEYS_KEYMAP_FILE "/nonexistent/keys.keymap"
+#undef KEYS_SETTINGS_FILE
+#define KEYS_SETTINGS_FILE "/nonexistent/keys.conf"
+#undef KEYS_INPUT_DIR
+#define KEYS_INPUT_DIR "/nonexistent"
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../keys.c"
+#include "../keys_keymap.c"
+#include "../keys_settings.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+//
+// Count heap allocations by interposing malloc and friends. This also
+// catches the allocations glib does on behalf of the UUT.
+//
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+#define MAX_BENCH_KEYBOARDS 2
+#define BULK_EVENTS         32
+
+// key events written per keyboard before draining, with their EV_SYN they
+// stay well below the capacity of a pipe
+#define BATCH_EVENTS        256
+
+typedef enum
+{
+	MODE_SINGLE,        // keys_get_event() for every event
+	MODE_BULK,          // keys_get_events() for BULK_EVENTS at a time
+	NUM_MODES
+} bench_mode_t;
+
+static const char *const mode_names[NUM_MODES] =
+{
+	[MODE_SINGLE] = "single",
+	[MODE_BULK] = "bulk",
+};
+
+typedef struct
+{
+	double eventsPerSec;
+	double nsPerEvent;
+	double allocsPerEvent;
+} result_t;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//
+// Writes a batch of presses and releases to a keyboard, time stamps
+// interleaved with those of the other keyboards so they have to be merged.
+//
+static void write_batch(int fd, int keyboard, int numKeyboards, int batch)
+{
+	InputEvent_t events[2 * BATCH_EVENTS];
+	int i;
+
+	memset(events, 0, sizeof(events));
+
+	for (i = 0; i < BATCH_EVENTS; i++)
+	{
+		long us = ((long) batch * BATCH_EVENTS + i) * numKeyboards + keyboard;
+
+		events[2 * i].time.tv_sec = us / 1000000;
+		events[2 * i].time.tv_usec = us % 1000000;
+		events[2 * i].type = EV_KEY;
+		events[2 * i].code = KEY_A + (i / 2) % 26;
+		events[2 * i].value = !(i & 1);
+		events[2 * i + 1].time = events[2 * i].time;
+		events[2 * i + 1].type = EV_SYN;
+	}
+
+	if (write(fd, events, sizeof(events)) != sizeof(events))
+	{
+		fprintf(stderr, "short write to keyboard %d\n", keyboard);
+		exit(1);
+	}
+}
+
+static int deliver(nyx_device_t *device, bench_mode_t mode)
+{
+	nyx_event_t *events[BULK_EVENTS];
+	int delivered = 0;
+	int numEvents = 0;
+	int i;
+
+	for (;;)
+	{
+		if (mode == MODE_SINGLE)
+		{
+			numEvents = 0;
+			keys_get_event(device, &events[0]);
+
+			if (events[0] != NULL)
+			{
+				numEvents = 1;
+			}
+		}
+		else
+		{
+			keys_get_events(device, events, BULK_EVENTS, &numEvents);
+		}
+
+		if (numEvents == 0)
+		{
+			return delivered;
+		}
+
+		for (i = 0; i < numEvents; i++)
+		{
+			keys_release_event(device, events[i]);
+		}
+
+		delivered += numEvents;
+	}
+}
+
+static void run_bench(bench_mode_t mode, int numKeyboards, int numEvents,
+                      result_t *result)
+{
+	int pipes[MAX_BENCH_KEYBOARDS][2];
+	nyx_device_t *device = NULL;
+	unsigned long startAllocations;
+	unsigned long deliverAllocations = 0;
+	double elapsed = 0;
+	long delivered = 0;
+	int batch, i;
+
+	nyx_module_open(NULL, &device);
+	g_assert(device != NULL);
+
+	for (i = 0; i < numKeyboards; i++)
+	{
+		if (pipe2(pipes[i], O_NONBLOCK) < 0)
+		{
+			perror("pipe2");
+			exit(1);
+		}
+
+		add_source((keys_device_t *) device, pipes[i][0]);
+	}
+
+	keypad_event_fd = pipes[0][0];
+
+	if (init_event_source((keys_device_t *) device) < 0)
+	{
+		fprintf(stderr, "failed to set up the event source\n");
+		exit(1);
+	}
+
+	for (batch = 0; delivered < numEvents; batch++)
+	{
+		double start;
+
+		for (i = 0; i < numKeyboards; i++)
+		{
+			write_batch(pipes[i][1], i, numKeyboards, batch);
+		}
+
+		startAllocations = allocations;
+		start = now_ns();
+		delivered += deliver(device, mode);
+		elapsed += now_ns() - start;
+		deliverAllocations += allocations - startAllocations;
+	}
+
+	result->nsPerEvent = elapsed / delivered;
+	result->eventsPerSec = delivered / (elapsed / 1e9);
+	result->allocsPerEvent = (double) deliverAllocations / delivered;
+
+	nyx_module_close(device);
+
+	for (i = 0; i < numKeyboards; i++)
+	{
+		close(pipes[i][0]);
+		close(pipes[i][1]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	int numEvents = 1000000;
+	bool first = true;
+	int mode, keyboards, i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+		{
+			numEvents = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--json] [--events N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (numEvents <= 0)
+	{
+		fprintf(stderr, "number of events must be positive\n");
+		return 1;
+	}
+
+	if (json)
+	{
+		printf("{\n  \"benchmark\": \"keys_get_event\",\n"
+		       "  \"events\": %d,\n  \"results\": [", numEvents);
+	}
+	else
+	{
+		printf("%-8s %9s %14s %12s %14s\n", "mode", "keyboards", "events/s",
+		       "ns/event", "allocs/event");
+	}
+
+	for (mode = 0; mode < NUM_MODES; mode++)
+	{
+		for (keyboards = 1; keyboards <= MAX_BENCH_KEYBOARDS; keyboards++)
+		{
+			result_t result;
+
+			run_bench(mode, keyboards, numEvents, &result);
+
+			if (json)
+			{
+				printf("%s\n    {\"mode\": \"%s\", \"keyboards\": %d, "
+				       "\"events_per_sec\": %.0f, \"ns_per_event\": %.1f, "
+				       "\"allocs_per_event\": %.3f}", first ? "" : ",",
+				       mode_names[mode], keyboards, result.eventsPerSec,
+				       result.nsPerEvent, result.allocsPerEvent);
+				first = false;
+			}
+			else
+			{
+				printf("%-8s %9d %14.0f %12.1f %14.3f\n", mode_names[mode], keyboards,
+				       result.eventsPerSec, result.nsPerEvent, result.allocsPerEvent);
+			}
+		}
+	}
+
+	if (json)
+	{
+		printf("\n  ]\n}\n");
+	}
+
+	return 0;
+}
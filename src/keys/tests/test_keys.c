@@ -0,0 +1,896 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glib.h>
+#include <stdio.h>
+#include <poll.h>
+
+//
+// Provide missing g_test macros if they are not defined in this version.
+//
+// We can't simply back-port the real definitions from glib as that would
+// would change the license for this component.
+//
+
+#ifndef g_assert_true
+#define g_assert_true(X) g_assert((X))
+#endif
+
+#ifndef g_assert_false
+#define g_assert_false(X) g_assert(!(X))
+#endif
+
+#ifndef g_assert_nonnull
+#define g_assert_nonnull(X) g_assert((X) != NULL)
+#endif
+
+#ifndef g_assert_null
+#define g_assert_null(X) g_assert((X) == NULL)
+#endif
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+// As we never actually call into nyx-lib, our nyx-lib instance
+// can be anything we want it to be.
+static nyx_instance_t the_instance = "an instance";
+
+//
+// Mock out the nyx call to register device methods
+//
+nyx_error_t nyx_module_register_method(nyx_instance_t instance,
+                                       nyx_device_t *device_in_ptr,
+                                       module_method_t method,
+                                       const char *symbol_str)
+{
+	g_assert_true(instance == the_instance);
+	return NYX_ERROR_NONE;
+}
+
+//
+// Keep the UUT away from the keyboards and the files of the machine the
+// tests run on: every test starts from the built-in settings and keymap and
+// feeds the module through pipes.
+//
+#undef KEYPAD_INPUT_DEVICE
+#undef KEYS_KEYMAP_FILE
+#define KEYS_KEYMAP_FILE "/nonexistent/keys.keymap"
+#undef KEYS_SETTINGS_FILE
+#define KEYS_SETTINGS_FILE "/nonexistent/keys.conf"
+#undef KEYS_INPUT_DIR
+#define KEYS_INPUT_DIR "/nonexistent"
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../keys.c"
+#include "../keys_keymap.c"
+#include "../keys_settings.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+//
+// All tests for API methods need an opened device (and need to close
+// it afterwards), so they should use the following fixture, along with the
+// setup and teardown functions.
+//
+// For ease, these tests can be added using the ADD_APITEST macro
+//
+
+#define MAX_TEST_KEYBOARDS  2
+
+typedef struct
+{
+	nyx_device_t *fixture_device;
+	int pipes[MAX_TEST_KEYBOARDS][2];
+	int num_keyboards;
+} api_test_fixture;
+
+static void api_test_setup(api_test_fixture *fixture, gconstpointer unused)
+{
+	memset(fixture, 0, sizeof(*fixture));
+	g_assert_true(nyx_module_open(the_instance,
+	                              &fixture->fixture_device) == NYX_ERROR_NONE);
+	g_assert_nonnull(fixture->fixture_device);
+}
+
+static void api_test_teardown(api_test_fixture *fixture, gconstpointer unused)
+{
+	int i;
+
+	// Closing the module should never fail
+	g_assert_true(nyx_module_close(fixture->fixture_device) == NYX_ERROR_NONE);
+	fixture->fixture_device = NULL;
+
+	for (i = 0; i < fixture->num_keyboards; i++)
+	{
+		close(fixture->pipes[i][0]);
+		close(fixture->pipes[i][1]);
+	}
+}
+
+#define ADD_APITEST(path, func) g_test_add(path, api_test_fixture, NULL, api_test_setup, func, api_test_teardown)
+
+//
+// Hook up numKeyboards pipes as keyboards, the first one as keypad_event_fd.
+// Settings that change the event source must be made before.
+//
+static void attach_keyboards(api_test_fixture *fixture, int numKeyboards)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	int i;
+
+	for (i = 0; i < numKeyboards; i++)
+	{
+		g_assert_true(pipe2(fixture->pipes[i], O_NONBLOCK) == 0);
+		add_source(keys_device, fixture->pipes[i][0]);
+	}
+
+	keypad_event_fd = fixture->pipes[0][0];
+	fixture->num_keyboards = numKeyboards;
+	g_assert_true(init_event_source(keys_device) == 0);
+}
+
+static void write_event(api_test_fixture *fixture, int keyboard, int ms,
+                        uint16_t type, uint16_t code, int32_t value)
+{
+	InputEvent_t event;
+
+	memset(&event, 0, sizeof(event));
+	event.time.tv_sec = ms / 1000;
+	event.time.tv_usec = (ms % 1000) * 1000;
+	event.type = type;
+	event.code = code;
+	event.value = value;
+
+	g_assert_true(write(fixture->pipes[keyboard][1], &event,
+	                    sizeof(event)) == sizeof(event));
+}
+
+// a key event followed by its EV_SYN, as the kernel reports them
+static void write_key(api_test_fixture *fixture, int keyboard, int ms,
+                      uint16_t code, int32_t value)
+{
+	write_event(fixture, keyboard, ms, EV_KEY, code, value);
+	write_event(fixture, keyboard, ms, EV_SYN, SYN_REPORT, 0);
+}
+
+static bool event_source_ready(api_test_fixture *fixture)
+{
+	struct pollfd pfd = { 0, POLLIN, 0 };
+
+	g_assert_true(keys_get_event_source(fixture->fixture_device,
+	                                    &pfd.fd) == NYX_ERROR_NONE);
+
+	return poll(&pfd, 1, 0) == 1;
+}
+
+//
+// Get the next event, check it and release it
+//
+static void expect_key(api_test_fixture *fixture, int32_t key,
+                       nyx_key_type_t type, bool isPress, bool isAutoRepeat)
+{
+	nyx_event_t *event = NULL;
+	nyx_event_keys_t *key_event;
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &event) == NYX_ERROR_NONE);
+	g_assert_nonnull(event);
+
+	key_event = (nyx_event_keys_t *) event;
+	g_assert_cmpint(key_event->key, ==, key);
+	g_assert_cmpint(key_event->key_type, ==, type);
+	g_assert_true(key_event->key_is_press == isPress);
+	g_assert_true(key_event->key_is_auto_repeat == isAutoRepeat);
+
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 event) == NYX_ERROR_NONE);
+}
+
+static void expect_no_event(api_test_fixture *fixture)
+{
+	nyx_event_t *event = NULL;
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &event) == NYX_ERROR_NONE);
+	g_assert_null(event);
+}
+
+// a file of its own in the temp dir, copies of the test may run side by side
+static gchar *temp_file(const char *pName)
+{
+	gchar *name = g_strdup_printf("%d-%s", (int) getpid(), pName);
+	gchar *path = g_build_filename(g_get_tmp_dir(), name, NULL);
+
+	g_free(name);
+	return path;
+}
+
+static void write_file(const char *pPath, const char *pContents)
+{
+	g_assert_true(g_file_set_contents(pPath, pContents, -1, NULL));
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+static void test_module_open()
+{
+	nyx_device_t *test_device = NULL;
+	int fd = -1;
+
+	g_assert_true(nyx_module_open(the_instance, NULL) == NYX_ERROR_INVALID_VALUE);
+
+	g_assert_true(nyx_module_open(the_instance, &test_device) == NYX_ERROR_NONE);
+	g_assert_nonnull(test_device);
+	g_assert_true(keys_get_event_source(test_device, &fd) == NYX_ERROR_NONE);
+	g_assert_true(nyx_module_close(test_device) == NYX_ERROR_NONE);
+
+	g_assert_true(nyx_module_close(NULL) == NYX_ERROR_INVALID_HANDLE);
+}
+
+static void test_keys_get_event(api_test_fixture *fixture,
+                                gconstpointer unused)
+{
+	nyx_event_t *event = (nyx_event_t *) 1;
+
+	attach_keyboards(fixture, 1);
+
+	// nothing to read
+	g_assert_false(event_source_ready(fixture));
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &event) == NYX_ERROR_NONE);
+	g_assert_null(event);
+
+	// a standard key is reported as its evdev code, a custom one as mapped
+	write_key(fixture, 0, 1, KEY_A, 1);
+	write_key(fixture, 0, 2, KEY_A, 0);
+	write_key(fixture, 0, 3, KEY_VOLUMEUP, 1);
+	write_key(fixture, 0, 4, KEY_VOLUMEUP, 0);
+	g_assert_true(event_source_ready(fixture));
+
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_VOL_UP, NYX_KEY_TYPE_CUSTOM, true,
+	           false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_VOL_UP, NYX_KEY_TYPE_CUSTOM, false,
+	           false);
+	expect_no_event(fixture);
+	g_assert_false(event_source_ready(fixture));
+
+	// events of other types are skipped, kernel repeats passed on
+	write_event(fixture, 0, 5, EV_MSC, MSC_SCAN, 0x1e);
+	write_key(fixture, 0, 5, KEY_B, 1);
+	write_key(fixture, 0, 6, KEY_B, 2);
+	write_key(fixture, 0, 7, KEY_B, 0);
+
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, true, true);
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_no_event(fixture);
+}
+
+static void test_keys_release_event(api_test_fixture *fixture,
+                                    gconstpointer unused)
+{
+	nyx_event_keys_t not_from_pool;
+
+	g_assert_true(keys_release_event(NULL,
+	                                 (nyx_event_t *) &not_from_pool) == NYX_ERROR_INVALID_HANDLE);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 NULL) == NYX_ERROR_INVALID_HANDLE);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 (nyx_event_t *) &not_from_pool) == NYX_ERROR_INVALID_VALUE);
+}
+
+//
+// Events released twice, or pointers into the pool that are not an event,
+// are turned away and don't corrupt the pool.
+//
+static void test_keys_release_event_twice(api_test_fixture *fixture,
+                                          gconstpointer unused)
+{
+	nyx_event_t *first = NULL;
+	nyx_event_t *second = NULL;
+
+	attach_keyboards(fixture, 1);
+	write_key(fixture, 0, 1, KEY_A, 1);
+	write_key(fixture, 0, 2, KEY_B, 1);
+	write_key(fixture, 0, 3, KEY_C, 1);
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &first) == NYX_ERROR_NONE);
+	g_assert_nonnull(first);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 (nyx_event_t *)((char *) first + 1)) == NYX_ERROR_INVALID_VALUE);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 first) == NYX_ERROR_NONE);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 first) == NYX_ERROR_INVALID_VALUE);
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &first) == NYX_ERROR_NONE);
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &second) == NYX_ERROR_NONE);
+	g_assert_nonnull(first);
+	g_assert_nonnull(second);
+	g_assert_true(first != second);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 first) == NYX_ERROR_NONE);
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 second) == NYX_ERROR_NONE);
+}
+
+//
+// The caller holding every event of the pool stalls the device, it mustn't
+// lose input.
+//
+static void test_event_pool_exhausted(api_test_fixture *fixture,
+                                      gconstpointer unused)
+{
+	// the last events of the pool are kept for priority keys
+	const int poolSize = KEYS_EVENT_POOL_SIZE - KEYS_PRIORITY_RESERVED;
+	nyx_event_t *held[KEYS_EVENT_POOL_SIZE];
+	nyx_event_t *event = NULL;
+	int i;
+
+	attach_keyboards(fixture, 1);
+
+	for (i = 0; i < poolSize + 2; i++)
+	{
+		write_key(fixture, 0, i, KEY_1 + i % 10, i & 1);
+	}
+
+	for (i = 0; i < poolSize; i++)
+	{
+		g_assert_true(keys_get_event(fixture->fixture_device,
+		                             &held[i]) == NYX_ERROR_NONE);
+		g_assert_nonnull(held[i]);
+	}
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &event) == NYX_ERROR_NONE);
+	g_assert_null(event);
+	g_assert_false(event_source_ready(fixture));
+
+	g_assert_true(keys_release_event(fixture->fixture_device,
+	                                 held[0]) == NYX_ERROR_NONE);
+	g_assert_true(event_source_ready(fixture));
+	expect_key(fixture, KEY_1 + poolSize % 10, NYX_KEY_TYPE_STANDARD,
+	           false, false);
+	expect_key(fixture, KEY_1 + (poolSize + 1) % 10,
+	           NYX_KEY_TYPE_STANDARD, true, false);
+	expect_no_event(fixture);
+
+	for (i = 1; i < poolSize; i++)
+	{
+		g_assert_true(keys_release_event(fixture->fixture_device,
+		                                 held[i]) == NYX_ERROR_NONE);
+	}
+}
+
+static void test_keys_get_events(api_test_fixture *fixture,
+                                 gconstpointer unused)
+{
+	nyx_event_t *events[8];
+	int numEvents = -1;
+	int i;
+
+	g_assert_true(keys_get_events(NULL, events, 8,
+	                              &numEvents) == NYX_ERROR_INVALID_HANDLE);
+	g_assert_true(keys_get_events(fixture->fixture_device, NULL, 8,
+	                              &numEvents) == NYX_ERROR_INVALID_VALUE);
+	g_assert_true(keys_get_events(fixture->fixture_device, events, 8,
+	                              NULL) == NYX_ERROR_INVALID_VALUE);
+
+	attach_keyboards(fixture, 1);
+
+	for (i = 0; i < 5; i++)
+	{
+		write_key(fixture, 0, i, KEY_Z, !(i & 1));
+	}
+
+	g_assert_true(keys_get_events(fixture->fixture_device, events, 3,
+	                              &numEvents) == NYX_ERROR_NONE);
+	g_assert_cmpint(numEvents, ==, 3);
+
+	for (i = 0; i < numEvents; i++)
+	{
+		keys_release_event(fixture->fixture_device, events[i]);
+	}
+
+	g_assert_true(keys_get_events(fixture->fixture_device, events, 8,
+	                              &numEvents) == NYX_ERROR_NONE);
+	g_assert_cmpint(numEvents, ==, 2);
+
+	for (i = 0; i < numEvents; i++)
+	{
+		keys_release_event(fixture->fixture_device, events[i]);
+	}
+}
+
+//
+// Events of several keyboards are delivered in the order of their kernel
+// time stamps.
+//
+static void test_keyboards_merged(api_test_fixture *fixture,
+                                  gconstpointer unused)
+{
+	attach_keyboards(fixture, 2);
+
+	write_key(fixture, 0, 10, KEY_A, 1);
+	write_key(fixture, 0, 30, KEY_A, 0);
+	write_key(fixture, 1, 20, KEY_B, 1);
+	write_key(fixture, 1, 40, KEY_B, 0);
+
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_no_event(fixture);
+}
+
+static void test_keymap_load()
+{
+	gchar *path = temp_file("test_keys.keymap");
+	keymap_presses_t longPresses, multiPresses;
+	keymap_chords_t chords;
+	keymap_t keymap;
+
+	keymap_init_defaults(keymap);
+	memset(&chords, 0, sizeof(chords));
+	memset(&longPresses, 0, sizeof(longPresses));
+	memset(&multiPresses, 0, sizeof(multiPresses));
+	g_assert_cmpint(keymap[KEY_A].key, ==, KEY_A);
+	g_assert_cmpint(keymap[KEY_POWER].key, ==, NYX_KEYS_CUSTOM_KEY_POWER_ON);
+	g_assert_cmpint(keymap[KEY_POWER].type, ==, NYX_KEY_TYPE_CUSTOM);
+
+	write_file(path, "[Keymap]\n30=Home\n0x31=F1\n\n"
+	           "[Chords]\nOrange+103=BrightnessUp\n\n"
+	           "[LongPress]\n102=Hot\n\n[MultiPress]\n116=Search\n");
+	g_assert_cmpint(keymap_load(path, keymap, &chords, &longPresses,
+	                            &multiPresses), ==, 0);
+	g_assert_cmpint(keymap[KEY_A].key, ==, NYX_KEYS_CUSTOM_KEY_HOME);
+	g_assert_cmpint(keymap[KEY_A].type, ==, NYX_KEY_TYPE_CUSTOM);
+	g_assert_cmpint(keymap[KEY_N].key, ==, F1);
+	g_assert_cmpint(chords.num_chords, ==, 1);
+	g_assert_cmpint(chords.chords[0].modifiers, ==, KEYS_MODIFIER_ORANGE);
+	g_assert_cmpint(chords.chords[0].code, ==, KEY_UP);
+	g_assert_cmpint(keymap_find_press(&longPresses, KEY_HOME)->key, ==,
+	                NYX_KEYS_CUSTOM_KEY_HOT);
+	g_assert_null(keymap_find_press(&longPresses, KEY_POWER));
+	g_assert_cmpint(keymap_find_press(&multiPresses, KEY_POWER)->key, ==,
+	                NYX_KEYS_CUSTOM_KEY_SEARCH);
+
+	// one bad entry and nothing changes
+	write_file(path, "[Keymap]\n30=Back\n31=NoSuchKey\n");
+	g_assert_cmpint(keymap_load(path, keymap, &chords, &longPresses,
+	                            &multiPresses), ==, -1);
+	g_assert_cmpint(keymap[KEY_A].key, ==, NYX_KEYS_CUSTOM_KEY_HOME);
+
+	write_file(path, "[Chords]\nHyper+103=Home\n");
+	g_assert_cmpint(keymap_load(path, keymap, &chords, &longPresses,
+	                            &multiPresses), ==, -1);
+	g_assert_cmpint(chords.num_chords, ==, 1);
+
+	write_file(path, "[LongPress]\n102=Back\n\n[MultiPress]\n0x10000=Home\n");
+	g_assert_cmpint(keymap_load(path, keymap, &chords, &longPresses,
+	                            &multiPresses), ==, -1);
+	g_assert_cmpint(keymap_find_press(&longPresses, KEY_HOME)->key, ==,
+	                NYX_KEYS_CUSTOM_KEY_HOT);
+
+	g_assert_cmpint(keymap_load("/nonexistent/keys.keymap", keymap, &chords,
+	                            &longPresses, &multiPresses), ==, -1);
+
+	unlink(path);
+	g_free(path);
+}
+
+static void test_settings_load()
+{
+	gchar *path = temp_file("test_keys.conf");
+	keys_settings_t settings = sDefaultSettings;
+
+	write_file(path, "[Repeat]\nSoftware=1\nDelay=250\n\n"
+	           "[Press]\nLongPress=600\n\n[Debounce]\nWindow=30\n");
+	g_assert_cmpint(load_keys_settings(path, &settings), ==, 0);
+	g_assert_cmpint(settings.softwareRepeat, ==, 1);
+	g_assert_cmpint(settings.repeatDelay, ==, 250);
+	g_assert_cmpint(settings.repeatInterval, ==, sDefaultSettings.repeatInterval);
+	g_assert_cmpint(settings.longPress, ==, 600);
+	g_assert_cmpint(settings.debounceWindow, ==, 30);
+
+	// out of range, or not a custom key, and nothing changes
+	write_file(path, "[Repeat]\nDelay=100\nMaxQueued=0\n");
+	g_assert_cmpint(load_keys_settings(path, &settings), ==, -1);
+	g_assert_cmpint(settings.repeatDelay, ==, 250);
+
+	write_file(path, "[Press]\nLongPress=700\n\n[Priority]\nKeys=F1\n");
+	g_assert_cmpint(load_keys_settings(path, &settings), ==, -1);
+	g_assert_cmpint(settings.longPress, ==, 600);
+
+	unlink(path);
+	g_free(path);
+}
+
+static void test_chords(api_test_fixture *fixture, gconstpointer unused)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	keymap_chord_t *chord = &keys_device->chords.chords[0];
+	uint32_t modifiers = 0;
+
+	chord->modifiers = KEYS_MODIFIER_SHIFT | KEYS_MODIFIER_SYM;
+	chord->code = KEY_M;
+	chord->entry.key = NYX_KEYS_CUSTOM_KEY_VOL_MUTE;
+	chord->entry.type = NYX_KEY_TYPE_CUSTOM;
+	keys_device->chords.num_chords = 1;
+	keys_device->keymap[KEY_RIGHTMETA].key = KEY_SYM;
+
+	attach_keyboards(fixture, 1);
+
+	write_key(fixture, 0, 1, KEY_RIGHTMETA, 1);
+	write_key(fixture, 0, 2, KEY_M, 1);
+	write_key(fixture, 0, 3, KEY_M, 0);
+	write_key(fixture, 0, 4, KEY_LEFTSHIFT, 1);
+	write_key(fixture, 0, 5, KEY_M, 1);
+	write_key(fixture, 0, 6, KEY_LEFTSHIFT, 0);
+	write_key(fixture, 0, 7, KEY_RIGHTMETA, 0);
+	write_key(fixture, 0, 8, KEY_M, 0);
+
+	// Sym alone makes no chord
+	expect_key(fixture, KEY_SYM, NYX_KEY_TYPE_STANDARD, true, false);
+	g_assert_true(keys_get_modifiers(fixture->fixture_device,
+	                                 &modifiers) == NYX_ERROR_NONE);
+	g_assert_cmpuint(modifiers, ==, KEYS_MODIFIER_SYM);
+	expect_key(fixture, KEY_M, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_M, NYX_KEY_TYPE_STANDARD, false, false);
+
+	// Sym+Shift does, up to the release of the key
+	expect_key(fixture, KEY_LEFTSHIFT, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_VOL_MUTE, NYX_KEY_TYPE_CUSTOM, true,
+	           false);
+	expect_key(fixture, KEY_LEFTSHIFT, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_key(fixture, KEY_SYM, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_VOL_MUTE, NYX_KEY_TYPE_CUSTOM, false,
+	           false);
+
+	g_assert_true(keys_get_modifiers(fixture->fixture_device,
+	                                 &modifiers) == NYX_ERROR_NONE);
+	g_assert_cmpuint(modifiers, ==, 0);
+
+	// right Alt has the code of Orange
+	write_key(fixture, 0, 9, KEY_RIGHTALT, 1);
+	expect_key(fixture, KEY_ORANGE, NYX_KEY_TYPE_STANDARD, true, false);
+	g_assert_true(keys_get_modifiers(fixture->fixture_device,
+	                                 &modifiers) == NYX_ERROR_NONE);
+	g_assert_cmpuint(modifiers, ==, KEYS_MODIFIER_ORANGE);
+}
+
+//
+// Repeats left unread are capped at Repeat/MaxQueued, and kernel repeats
+// are dropped.
+//
+static void test_software_repeat(api_test_fixture *fixture,
+                                 gconstpointer unused)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	int i;
+
+	keys_device->settings.softwareRepeat = 1;
+	keys_device->settings.repeatDelay = 60 * 1000;
+	keys_device->settings.repeatInterval = 60 * 1000;
+	attach_keyboards(fixture, 1);
+
+	write_key(fixture, 0, 1, KEY_X, 1);
+	write_key(fixture, 0, 2, KEY_X, 2);
+	expect_key(fixture, KEY_X, NYX_KEY_TYPE_STANDARD, true, false);
+
+	// more than MaxQueued repeats are overdue, and the next one is a whole
+	// interval away, however long the test takes
+	keys_device->repeat_deadline = monotonic_ms() -
+	                               keys_device->settings.maxQueuedRepeats *
+	                               keys_device->settings.repeatInterval;
+	update_event_source(keys_device);
+	g_assert_true(event_source_ready(fixture));
+
+	for (i = 0; i < keys_device->settings.maxQueuedRepeats; i++)
+	{
+		expect_key(fixture, KEY_X, NYX_KEY_TYPE_STANDARD, true, true);
+	}
+
+	write_key(fixture, 0, 3, KEY_X, 0);
+	expect_key(fixture, KEY_X, NYX_KEY_TYPE_STANDARD, false, false);
+	g_assert_cmpint(keys_device->repeat_code, ==, -1);
+	expect_no_event(fixture);
+
+	// modifiers don't repeat
+	write_key(fixture, 0, 4, KEY_LEFTCTRL, 1);
+	expect_key(fixture, KEY_LEFTCTRL, NYX_KEY_TYPE_STANDARD, true, false);
+	g_assert_cmpint(keys_device->repeat_code, ==, -1);
+	expect_no_event(fixture);
+}
+
+static void test_long_and_multi_press(api_test_fixture *fixture,
+                                      gconstpointer unused)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	int32_t home = NYX_KEYS_CUSTOM_KEY_HOME;
+	int32_t hot = NYX_KEYS_CUSTOM_KEY_HOT;
+	int32_t search = NYX_KEYS_CUSTOM_KEY_SEARCH;
+
+	keys_device->long_presses.presses[0].code = KEY_HOME;
+	keys_device->long_presses.presses[0].entry.key = hot;
+	keys_device->long_presses.presses[0].entry.type = NYX_KEY_TYPE_CUSTOM;
+	keys_device->long_presses.num_presses = 1;
+	keys_device->multi_presses.presses[0].code = KEY_HOME;
+	keys_device->multi_presses.presses[0].entry.key = search;
+	keys_device->multi_presses.presses[0].entry.type = NYX_KEY_TYPE_CUSTOM;
+	keys_device->multi_presses.num_presses = 1;
+	keys_device->settings.longPress = 1;
+	keys_device->settings.multiPress = 300;
+	attach_keyboards(fixture, 1);
+
+	write_key(fixture, 0, 1, KEY_HOME, 1);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, true, false);
+	g_usleep(10 * 1000);
+	expect_key(fixture, hot, NYX_KEY_TYPE_CUSTOM, true, false);
+
+	write_key(fixture, 0, 2, KEY_HOME, 0);
+	write_key(fixture, 0, 3, KEY_HOME, 1);
+	write_key(fixture, 0, 4, KEY_HOME, 0);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_key(fixture, hot, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, search, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, search, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_no_event(fixture);
+
+	// keys left out of [LongPress] and [MultiPress] are reported as they are
+	write_key(fixture, 0, 5, KEY_BACK, 1);
+	write_key(fixture, 0, 6, KEY_BACK, 0);
+	write_key(fixture, 0, 7, KEY_BACK, 1);
+	write_key(fixture, 0, 8, KEY_BACK, 0);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_BACK, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_BACK, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_BACK, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_BACK, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_no_event(fixture);
+
+	// presses further apart than Press/MultiPress by the kernel's time stamps
+	// aren't a multi press, even if they are read in one go
+	write_key(fixture, 0, 1000, KEY_HOME, 1);
+	write_key(fixture, 0, 1010, KEY_HOME, 0);
+	write_key(fixture, 0, 6000, KEY_HOME, 1);
+	write_key(fixture, 0, 6010, KEY_HOME, 0);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, true, false);
+	expect_key(fixture, home, NYX_KEY_TYPE_CUSTOM, false, false);
+	expect_no_event(fixture);
+}
+
+//
+// A power key press behind a burst of typing is delivered first, and its
+// latency counted apart.
+//
+static void test_priority_keys(api_test_fixture *fixture,
+                               gconstpointer unused)
+{
+	nyx_event_t *held[KEYS_EVENT_POOL_SIZE];
+	nyx_event_t *event = NULL;
+	keys_stats_t stats;
+	int i;
+
+	attach_keyboards(fixture, 1);
+
+	for (i = 0; i < 100; i++)
+	{
+		write_key(fixture, 0, i, KEY_A, !(i & 1));
+	}
+
+	write_key(fixture, 0, 100, KEY_END, 1);
+	write_key(fixture, 0, 101, KEY_END, 0);
+
+	g_assert_true(keys_get_event(fixture->fixture_device,
+	                             &event) == NYX_ERROR_NONE);
+	g_assert_nonnull(event);
+	g_assert_cmpint(((nyx_event_keys_t *) event)->key, ==,
+	                NYX_KEYS_CUSTOM_KEY_POWER_ON);
+	g_assert_true(keys_event_is_priority(fixture->fixture_device, event));
+	keys_release_event(fixture->fixture_device, event);
+
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM, false,
+	           false);
+
+	// the caller holding on to events doesn't hold up priority keys
+	for (i = 0; i < KEYS_EVENT_POOL_SIZE - KEYS_PRIORITY_RESERVED; i++)
+	{
+		g_assert_true(keys_get_event(fixture->fixture_device,
+		                             &held[i]) == NYX_ERROR_NONE);
+		g_assert_nonnull(held[i]);
+		g_assert_false(keys_event_is_priority(fixture->fixture_device, held[i]));
+	}
+
+	expect_no_event(fixture);
+	write_key(fixture, 0, 200, KEY_POWER, 1);
+	g_assert_true(event_source_ready(fixture));
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM, true,
+	           false);
+
+	for (i = 0; i < KEYS_EVENT_POOL_SIZE - KEYS_PRIORITY_RESERVED; i++)
+	{
+		keys_release_event(fixture->fixture_device, held[i]);
+	}
+
+	// the pipe's time stamps are way off, so no latencies are counted
+	g_assert_true(keys_get_stats(fixture->fixture_device,
+	                             &stats) == NYX_ERROR_NONE);
+	g_assert_cmpuint(stats.priority.count, ==, 0);
+	g_assert_true(keys_get_stats(fixture->fixture_device,
+	                             NULL) == NYX_ERROR_INVALID_VALUE);
+}
+
+//
+// A priority key pressed while the priority ring is full is released in the
+// ring it was pressed in, and a priority key read behind a full ring is only
+// pulled ahead of the ring if it is next on its keyboard.
+//
+static void test_priority_pairs(api_test_fixture *fixture,
+                                gconstpointer unused)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	keys_source_t *source;
+	int i;
+
+	attach_keyboards(fixture, 1);
+
+	for (i = 0; i < KEYS_PRIORITY_RING_SIZE; i++)
+	{
+		write_key(fixture, 0, i, KEY_END, !(i & 1));
+	}
+
+	write_key(fixture, 0, 100, KEY_POWER, 1);
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM, true,
+	           false);
+	write_key(fixture, 0, 101, KEY_POWER, 0);
+
+	for (i = 1; i < KEYS_PRIORITY_RING_SIZE + 2; i++)
+	{
+		expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM,
+		           !(i & 1), false);
+	}
+
+	expect_no_event(fixture);
+
+	for (i = 0; i < KEYS_RING_SIZE; i++)
+	{
+		write_key(fixture, 0, 200 + i, KEY_A, !(i & 1));
+	}
+
+	write_key(fixture, 0, 500, KEY_END, 1);
+	write_key(fixture, 0, 501, KEY_END, 0);
+	write_key(fixture, 0, 502, KEY_B, 1);
+	write_key(fixture, 0, 503, KEY_END, 1);
+	write_key(fixture, 0, 504, KEY_B, 0);
+	write_key(fixture, 0, 505, KEY_END, 0);
+
+	// the second press of the power key waits behind the one of KEY_B
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM, true,
+	           false);
+	g_assert_cmpuint(keys_device->priority_tail - keys_device->priority_head, ==,
+	                 1);
+	g_assert_cmpuint(keys_device->ring_tail - keys_device->ring_head, ==,
+	                 KEYS_RING_SIZE);
+	source = &keys_device->sources[0];
+	g_assert_cmpint(source->raw_events[source->event_iter].code, ==, KEY_B);
+
+	expect_key(fixture, NYX_KEYS_CUSTOM_KEY_POWER_ON, NYX_KEY_TYPE_CUSTOM, false,
+	           false);
+
+	for (i = 0; i < KEYS_RING_SIZE + 4; i++)
+	{
+		nyx_event_t *event = NULL;
+
+		g_assert_true(keys_get_event(fixture->fixture_device,
+		                             &event) == NYX_ERROR_NONE);
+		g_assert_nonnull(event);
+		keys_release_event(fixture->fixture_device, event);
+	}
+
+	expect_no_event(fixture);
+}
+
+//
+// A press and release repeated within Debounce/Window, and presses and
+// releases repeated without one in between, are dropped and counted.
+//
+static void test_debounce(api_test_fixture *fixture, gconstpointer unused)
+{
+	keys_device_t *keys_device = (keys_device_t *) fixture->fixture_device;
+	keys_stats_t stats;
+
+	keys_device->settings.debounceWindow = 20;
+	attach_keyboards(fixture, 1);
+
+	write_key(fixture, 0, 1000, KEY_A, 1);
+	write_key(fixture, 0, 1005, KEY_A, 0);
+	write_key(fixture, 0, 1008, KEY_A, 1);
+	write_key(fixture, 0, 1009, KEY_A, 2);
+	write_key(fixture, 0, 1010, KEY_A, 0);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_no_event(fixture);
+
+	write_key(fixture, 0, 1100, KEY_A, 1);
+	write_key(fixture, 0, 1101, KEY_A, 1);
+	write_key(fixture, 0, 1150, KEY_A, 0);
+	write_key(fixture, 0, 1151, KEY_A, 0);
+	write_key(fixture, 0, 1152, KEY_B, 1);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_key(fixture, KEY_A, NYX_KEY_TYPE_STANDARD, false, false);
+	expect_key(fixture, KEY_B, NYX_KEY_TYPE_STANDARD, true, false);
+	expect_no_event(fixture);
+
+	g_assert_true(keys_get_stats(fixture->fixture_device,
+	                             &stats) == NYX_ERROR_NONE);
+	g_assert_cmpuint(stats.bounces, ==, 1);
+	g_assert_cmpuint(stats.duplicates, ==, 2);
+}
+
+//
+// Set-up GLib, then register and run the tests.
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/keys/api/module_open", test_module_open);
+	ADD_APITEST("/keys/api/keys_get_event", test_keys_get_event);
+	ADD_APITEST("/keys/api/keys_release_event", test_keys_release_event);
+	ADD_APITEST("/keys/api/keys_release_event_twice",
+	            test_keys_release_event_twice);
+	ADD_APITEST("/keys/api/keys_get_events", test_keys_get_events);
+	ADD_APITEST("/keys/input/event_pool_exhausted", test_event_pool_exhausted);
+	ADD_APITEST("/keys/input/keyboards_merged", test_keyboards_merged);
+	ADD_APITEST("/keys/input/chords", test_chords);
+	ADD_APITEST("/keys/input/software_repeat", test_software_repeat);
+	ADD_APITEST("/keys/input/long_and_multi_press", test_long_and_multi_press);
+	ADD_APITEST("/keys/input/priority_keys", test_priority_keys);
+	ADD_APITEST("/keys/input/priority_pairs", test_priority_pairs);
+	ADD_APITEST("/keys/input/debounce", test_debounce);
+	g_test_add_func("/keys/config/keymap_load", test_keymap_load);
+	g_test_add_func("/keys/config/settings_load", test_settings_load);
+
+	return g_test_run();
+}
@@ -0,0 +1,492 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Benchmark for the touch position filter.
+//
+// Runs synthetic traces, and optionally a recorded one, through the old +-1
+// position filter and through the 1 euro filter with a few parameter sets,
+// and reports how much jitter is left and how far the output lags behind.
+//
+// jitter:  RMS of the second difference of the output, in px
+// lag:     time shift in ms that best aligns the output with the reference
+//          signal (the noise free signal for synthetic traces, the raw one
+//          for recorded traces)
+//
+// A recorded trace is a text file with one "t_ms x y" sample per line.
+//
+// Usage: bench_filter [--json] [--trace FILE]
+//
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../touchpanel_filter.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+#define FRAME_INTERVAL_MS   8
+#define NUM_SAMPLES         2000
+#define MAX_LAG_MS          200
+
+typedef struct
+{
+	const char *name;
+	int numSamples;
+	double *t;          // ms
+	double *x[NUM_DIMENSIONS];
+	double *ref[NUM_DIMENSIONS];
+} trace_t;
+
+typedef enum
+{
+	FILTER_NONE,
+	FILTER_LEGACY,      // the +-1 filter the 1 euro filter replaced
+	FILTER_ONE_EURO
+} filter_type_t;
+
+typedef struct
+{
+	const char *name;
+	filter_type_t type;
+	double minCutoff;
+	double beta;
+} filter_desc_t;
+
+static const filter_desc_t filters[] =
+{
+	{ "none", FILTER_NONE, 0, 0 },
+	{ "legacy", FILTER_LEGACY, 0, 0 },
+	{ "1euro(1.0,0.001)", FILTER_ONE_EURO, 1.0, 0.001 },
+	{ "1euro(1.0,0.007)", FILTER_ONE_EURO, 1.0, 0.007 },
+	{ "1euro(1.0,0.05)", FILTER_ONE_EURO, 1.0, 0.05 },
+	{ "1euro(3.0,0.007)", FILTER_ONE_EURO, 3.0, 0.007 },
+};
+
+// deterministic noise, so every run sees the same traces
+static unsigned int noise_state = 1;
+
+static double noise(double amplitude)
+{
+	noise_state = noise_state * 1103515245 + 12345;
+	return ((int)((noise_state >> 16) % 2001) - 1000) * amplitude / 1000.0;
+}
+
+static void trace_alloc(trace_t *trace, const char *name, int numSamples)
+{
+	int dim;
+
+	trace->name = name;
+	trace->numSamples = numSamples;
+	trace->t = calloc(numSamples, sizeof(double));
+	g_assert(trace->t != NULL);
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		trace->x[dim] = calloc(numSamples, sizeof(double));
+		trace->ref[dim] = calloc(numSamples, sizeof(double));
+		g_assert(trace->x[dim] != NULL && trace->ref[dim] != NULL);
+	}
+}
+
+static void trace_free(trace_t *trace)
+{
+	int dim;
+
+	free(trace->t);
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		free(trace->x[dim]);
+		free(trace->ref[dim]);
+	}
+}
+
+// a finger held still, a slow and a fast straight swipe, and a circle
+static void make_synthetic(trace_t *trace, int which)
+{
+	static const char *const names[] = { "still", "slow", "fast", "circle" };
+	int n;
+
+	trace_alloc(trace, names[which], NUM_SAMPLES);
+
+	for (n = 0; n < NUM_SAMPLES; n++)
+	{
+		double t = n * FRAME_INTERVAL_MS;
+		double x = 500, y = 500;
+
+		switch (which)
+		{
+			case 1:
+				x += 0.1 * t;
+				break;
+
+			case 2:
+				x += 2.0 * t;
+				break;
+
+			case 3:
+				x += 200 * cos(2 * M_PI * t / 1000.0);
+				y += 200 * sin(2 * M_PI * t / 1000.0);
+				break;
+
+			default:
+				break;
+		}
+
+		trace->t[n] = t;
+		trace->ref[X_DIM][n] = x;
+		trace->ref[Y_DIM][n] = y;
+		trace->x[X_DIM][n] = round(x + noise(2.0));
+		trace->x[Y_DIM][n] = round(y + noise(2.0));
+	}
+}
+
+static bool load_trace(trace_t *trace, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	double t, x, y;
+	int size = 0;
+
+	if (!file)
+	{
+		perror(path);
+		return false;
+	}
+
+	while (fscanf(file, "%lf %lf %lf", &t, &x, &y) == 3)
+	{
+		size++;
+	}
+
+	if (size < 3)
+	{
+		fprintf(stderr, "%s: need at least 3 samples\n", path);
+		fclose(file);
+		return false;
+	}
+
+	trace_alloc(trace, path, size);
+	rewind(file);
+
+	for (size = 0; size < trace->numSamples &&
+	        fscanf(file, "%lf %lf %lf", &t, &x, &y) == 3; size++)
+	{
+		trace->t[size] = t;
+		trace->x[X_DIM][size] = trace->ref[X_DIM][size] = x;
+		trace->x[Y_DIM][size] = trace->ref[Y_DIM][size] = y;
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void run_filter(const trace_t *trace, const filter_desc_t *desc,
+                       double *out[NUM_DIMENSIONS])
+{
+	general_settings_t settings =
+	{
+		.filterMinCutoff = desc->minCutoff,
+		.filterBeta = desc->beta,
+		.filterDerivativeCutoff = 1.0
+	};
+	one_euro_filter_t filter[NUM_DIMENSIONS];
+	int dim, n;
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		one_euro_filter_reset(&filter[dim]);
+	}
+
+	for (n = 0; n < trace->numSamples; n++)
+	{
+		time_stamp_t time;
+
+		time.time.tv_sec = (time_t)(trace->t[n] / 1000);
+		time.time.tv_nsec = (long)((trace->t[n] - time.time.tv_sec * 1000.0) * 1e6);
+
+		for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+		{
+			double value = trace->x[dim][n];
+
+			switch (desc->type)
+			{
+				case FILTER_LEGACY:
+					if (n && value < out[dim][n - 1])
+					{
+						value++;
+					}
+					else if (n && value > out[dim][n - 1])
+					{
+						value--;
+					}
+
+					break;
+
+				case FILTER_ONE_EURO:
+					// the module rounds to whole px, so do the same here
+					value = round(one_euro_filter_apply(&filter[dim], value, &time,
+					                                    &settings));
+					break;
+
+				default:
+					break;
+			}
+
+			out[dim][n] = value;
+		}
+	}
+}
+
+static double rms_jitter(const trace_t *trace, double *out[NUM_DIMENSIONS])
+{
+	double sum = 0;
+	int dim, n;
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		for (n = 2; n < trace->numSamples; n++)
+		{
+			double d2 = out[dim][n] - 2 * out[dim][n - 1] + out[dim][n - 2];
+			sum += d2 * d2;
+		}
+	}
+
+	return sqrt(sum / (NUM_DIMENSIONS * (trace->numSamples - 2)));
+}
+
+// value of the reference signal at time t, linearly interpolated
+static double ref_at(const trace_t *trace, int dim, double t, int *pHint)
+{
+	int i = *pHint;
+
+	while (i + 1 < trace->numSamples - 1 && trace->t[i + 1] <= t)
+	{
+		i++;
+	}
+
+	*pHint = i;
+
+	if (trace->t[i + 1] == trace->t[i])
+	{
+		return trace->ref[dim][i];
+	}
+
+	return trace->ref[dim][i] + (trace->ref[dim][i + 1] - trace->ref[dim][i]) *
+	       (t - trace->t[i]) / (trace->t[i + 1] - trace->t[i]);
+}
+
+// shift in whole ms that minimizes the squared error to the reference, or -1
+// if the reference never moves and so any shift fits equally well
+static int estimate_lag(const trace_t *trace, double *out[NUM_DIMENSIONS])
+{
+	double bestError = INFINITY;
+	bool moving = false;
+	int bestLag = 0;
+	int lag, n;
+
+	for (n = 1; n < trace->numSamples && !moving; n++)
+	{
+		moving = trace->ref[X_DIM][n] != trace->ref[X_DIM][0] ||
+		         trace->ref[Y_DIM][n] != trace->ref[Y_DIM][0];
+	}
+
+	if (!moving)
+	{
+		return -1;
+	}
+
+	for (lag = 0; lag <= MAX_LAG_MS; lag++)
+	{
+		double error = 0;
+		int dim;
+
+		for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+		{
+			int hint = 0;
+
+			for (n = 0; n < trace->numSamples; n++)
+			{
+				double t = trace->t[n] - lag;
+				double d;
+
+				// skip the start, where there is no shifted reference yet
+				if (t < trace->t[0] + MAX_LAG_MS)
+				{
+					continue;
+				}
+
+				d = out[dim][n] - ref_at(trace, dim, t, &hint);
+				error += d * d;
+			}
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			bestLag = lag;
+		}
+	}
+
+	return bestLag;
+}
+
+static void run_trace(const trace_t *trace, bool json, bool *pFirst)
+{
+	double *out[NUM_DIMENSIONS];
+	double rawJitter = 0;
+	size_t i;
+	int dim;
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		out[dim] = calloc(trace->numSamples, sizeof(double));
+		g_assert(out[dim] != NULL);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(filters); i++)
+	{
+		double jitter;
+		int lag;
+
+		run_filter(trace, &filters[i], out);
+		jitter = rms_jitter(trace, out);
+		lag = estimate_lag(trace, out);
+
+		if (filters[i].type == FILTER_NONE)
+		{
+			rawJitter = jitter;
+		}
+
+		if (json)
+		{
+			printf("%s\n    {\"trace\": \"%s\", \"filter\": \"%s\", "
+			       "\"jitter_px\": %.3f, \"jitter_ratio\": %.3f, ",
+			       *pFirst ? "" : ",", trace->name, filters[i].name, jitter,
+			       rawJitter > 0 ? jitter / rawJitter : 1.0);
+
+			if (lag < 0)
+			{
+				printf("\"lag_ms\": null}");
+			}
+			else
+			{
+				printf("\"lag_ms\": %d}", lag);
+			}
+
+			*pFirst = false;
+		}
+		else
+		{
+			printf("%-10s %-18s %10.3f %8.3f ", trace->name, filters[i].name,
+			       jitter, rawJitter > 0 ? jitter / rawJitter : 1.0);
+
+			if (lag < 0)
+			{
+				printf("%7s\n", "-");
+			}
+			else
+			{
+				printf("%7d\n", lag);
+			}
+		}
+	}
+
+	for (dim = 0; dim < NUM_DIMENSIONS; dim++)
+	{
+		free(out[dim]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *tracePath = NULL;
+	bool json = false;
+	bool first = true;
+	trace_t trace;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--json] [--trace FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (json)
+	{
+		printf("{\n  \"benchmark\": \"position_filter\",\n  \"results\": [");
+	}
+	else
+	{
+		printf("%-10s %-18s %10s %8s %7s\n", "trace", "filter", "jitter(px)",
+		       "ratio", "lag(ms)");
+	}
+
+	for (i = 0; i < 4; i++)
+	{
+		make_synthetic(&trace, i);
+		run_trace(&trace, json, &first);
+		trace_free(&trace);
+	}
+
+	if (tracePath)
+	{
+		if (!load_trace(&trace, tracePath))
+		{
+			return 1;
+		}
+
+		run_trace(&trace, json, &first);
+		trace_free(&trace);
+	}
+
+	if (json)
+	{
+		printf("\n  ]\n}\n");
+	}
+
+	return 0;
+}
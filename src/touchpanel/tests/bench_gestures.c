@@ -0,0 +1,337 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Microbenchmark for the gesture engine.
+//
+// Drives gesture_state_machine() with synthetic traces and reports the time,
+// the number of heap allocations and the number of events emitted per frame.
+//
+// Usage: bench_gestures [--json] [--frames N]
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../touchpanel_common.c"
+#include "../touchpanel_trace.c"
+#include "../touchpanel_filter.c"
+#include "../touchpanel_gestures.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+//
+// Count heap allocations by interposing malloc and friends. This also
+// catches the allocations glib does on behalf of the UUT.
+//
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+#define MAX_BENCH_FINGERS   10
+#define SCREEN_WIDTH        1920
+#define SCREEN_HEIGHT       1080
+#define FRAME_INTERVAL_MS   8
+
+typedef enum
+{
+	TRACE_LINES,        // fingers moving along parallel straight lines
+	TRACE_CROSSINGS,    // pairs of fingers moving towards and past each other
+	TRACE_JITTER,       // fingers held still with a few px of noise
+	TRACE_TAPS,         // fingers going down and up every couple of frames
+	NUM_TRACES
+} trace_t;
+
+static const char *const trace_names[NUM_TRACES] =
+{
+	[TRACE_LINES] = "lines",
+	[TRACE_CROSSINGS] = "crossings",
+	[TRACE_JITTER] = "jitter",
+	[TRACE_TAPS] = "taps",
+};
+
+typedef struct
+{
+	int numFingers;
+	int x[MAX_BENCH_FINGERS];
+	int y[MAX_BENCH_FINGERS];
+	int weight[MAX_BENCH_FINGERS];
+	time_stamp_t time;
+} frame_t;
+
+typedef struct
+{
+	double nsPerFrame;
+	double allocsPerFrame;
+	double eventsPerFrame;
+} result_t;
+
+static general_settings_t settings =
+{
+	.coordBufSize = 6,
+	.fingerDownThreshold = 0,
+	.tapRadius = 10,
+	.tapTimeout = 300,
+	.doubleTapRadius = 30,
+	.doubleTapTimeout = 300,
+	.longPressTimeout = 500,
+	.flickMinVelocity = 500,
+	.filterMinCutoff = 1.0,
+	.filterBeta = 0.007,
+	.filterDerivativeCutoff = 1.0,
+	.edgeSwipeZone = 2,
+	.edgeSwipeDistance = 5,
+	.edgeSwipeTimeout = 500
+};
+
+static input_event_t events[4096 / sizeof(input_event_t)];
+
+// deterministic noise, so every run sees the same traces
+static unsigned int noise_state = 1;
+
+static int noise(int amplitude)
+{
+	noise_state = noise_state * 1103515245 + 12345;
+	return (int)((noise_state >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static void make_frame(frame_t *frame, trace_t trace, int fingers, int n)
+{
+	int i;
+
+	frame->time.time.tv_sec = (n * FRAME_INTERVAL_MS) / 1000;
+	frame->time.time.tv_nsec = ((n * FRAME_INTERVAL_MS) % 1000) * 1000000L;
+	frame->numFingers = fingers;
+
+	for (i = 0; i < fingers; i++)
+	{
+		int lane = (i + 1) * SCREEN_HEIGHT / (fingers + 1);
+		int step = n % 200;
+
+		frame->weight[i] = 1;
+
+		switch (trace)
+		{
+			case TRACE_LINES:
+				frame->x[i] = 100 + step * 8;
+				frame->y[i] = lane;
+				break;
+
+			case TRACE_CROSSINGS:
+				// odd fingers run the opposite way, meeting their partner halfway
+				frame->x[i] = (i & 1) ? SCREEN_WIDTH - 100 - step * 8 : 100 + step * 8;
+				frame->y[i] = (i / 2 + 1) * SCREEN_HEIGHT / (fingers / 2 + 2) +
+				              ((i & 1) ? -step : step);
+				break;
+
+			case TRACE_JITTER:
+				frame->x[i] = (i + 1) * SCREEN_WIDTH / (fingers + 1) + noise(3);
+				frame->y[i] = lane + noise(3);
+				break;
+
+			case TRACE_TAPS:
+				frame->x[i] = (i + 1) * SCREEN_WIDTH / (fingers + 1);
+				frame->y[i] = lane;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// down for two frames, up for one
+	if (trace == TRACE_TAPS && n % 3 == 2)
+	{
+		frame->numFingers = 0;
+	}
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_trace(trace_t trace, int fingers, int numFrames,
+                      result_t *result)
+{
+	frame_t *frames = calloc(numFrames + 1, sizeof(frame_t));
+	unsigned long totalEvents = 0;
+	unsigned long startAllocations;
+	double start;
+	int numEvents;
+	int n;
+
+	g_assert(frames != NULL);
+
+	for (n = 0; n < numFrames; n++)
+	{
+		make_frame(&frames[n], trace, fingers, n);
+	}
+
+	// lift all fingers at the end so the next trace starts clean
+	frames[numFrames].numFingers = 0;
+	frames[numFrames].time = frames[numFrames - 1].time;
+
+	startAllocations = allocations;
+	start = now_ns();
+
+	for (n = 0; n < numFrames; n++)
+	{
+		gesture_state_machine(frames[n].x, frames[n].y, frames[n].weight,
+		                      frames[n].numFingers, &frames[n].time,
+		                      events, G_N_ELEMENTS(events), &numEvents);
+		totalEvents += numEvents;
+	}
+
+	result->nsPerFrame = (now_ns() - start) / numFrames;
+	result->allocsPerFrame = (double)(allocations - startAllocations) / numFrames;
+	result->eventsPerFrame = (double)totalEvents / numFrames;
+
+	gesture_state_machine(frames[numFrames].x, frames[numFrames].y,
+	                      frames[numFrames].weight, 0, &frames[numFrames].time,
+	                      events, G_N_ELEMENTS(events), &numEvents);
+	free(frames);
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	int numFrames = 20000;
+	bool first = true;
+	int trace, fingers, i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			numFrames = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--json] [--frames N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (numFrames <= 0)
+	{
+		fprintf(stderr, "number of frames must be positive\n");
+		return 1;
+	}
+
+	init_gesture_state_machine(&settings, MAX_BENCH_FINGERS);
+
+	if (json)
+	{
+		printf("{\n  \"benchmark\": \"gesture_state_machine\",\n"
+		       "  \"frames\": %d,\n  \"results\": [", numFrames);
+	}
+	else
+	{
+		printf("%-10s %7s %12s %14s %14s\n", "trace", "fingers", "ns/frame",
+		       "allocs/frame", "events/frame");
+	}
+
+	for (trace = 0; trace < NUM_TRACES; trace++)
+	{
+		for (fingers = 1; fingers <= MAX_BENCH_FINGERS; fingers++)
+		{
+			result_t result;
+
+			run_trace(trace, fingers, numFrames, &result);
+
+			if (json)
+			{
+				printf("%s\n    {\"trace\": \"%s\", \"fingers\": %d, "
+				       "\"ns_per_frame\": %.1f, \"allocs_per_frame\": %.3f, "
+				       "\"events_per_frame\": %.2f}", first ? "" : ",",
+				       trace_names[trace], fingers, result.nsPerFrame,
+				       result.allocsPerFrame, result.eventsPerFrame);
+				first = false;
+			}
+			else
+			{
+				printf("%-10s %7d %12.1f %14.3f %14.2f\n", trace_names[trace], fingers,
+				       result.nsPerFrame, result.allocsPerFrame, result.eventsPerFrame);
+			}
+		}
+	}
+
+	if (json)
+	{
+		printf("\n  ]\n}\n");
+	}
+
+	deinit_gesture_state_machine();
+
+	return 0;
+}
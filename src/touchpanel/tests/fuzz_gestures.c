@@ -0,0 +1,209 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Fuzz target for the gesture engine.
+//
+// The input is decoded into frames of coordinates and weights that are fed to
+// gesture_state_machine() with an output buffer of fuzzed capacity:
+//
+//   frame:  u8 fingers, u8 time step in ms, u8 output capacity,
+//           fingers * (u16 x, u16 y, u8 weight)
+//
+// Checked after every frame:
+//  - no more events are reported than fit the output buffer, and nothing
+//    is written past it
+//  - no frame has more events than the engine can produce for the fingers
+//    it tracks
+//  - every finger is either in sFingers or in availableFingers
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../touchpanel_common.c"
+#include "../touchpanel_trace.c"
+#include "../touchpanel_filter.c"
+#include "../touchpanel_gestures.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+#define FUZZ_CHECK(condition)                                          \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: invariant violated: %s\n",               \
+              __FILE__, __LINE__, #condition);                         \
+      abort();                                                         \
+    }                                                                  \
+  } while(0)
+
+#define FUZZ_MAX_FINGERS        5
+// more than the engine has finger buffers for
+#define FUZZ_MAX_INPUT_FINGERS  (4 * FUZZ_MAX_FINGERS)
+// coordinates are kept to the range of real panels and displays
+#define FUZZ_COORD_MASK         0x0fff
+#define FUZZ_MAX_CAPACITY       256
+#define FUZZ_GUARD              0xa5
+
+static general_settings_t fuzz_settings =
+{
+	.coordBufSize = 6,
+	.fingerDownThreshold = 1,
+	.positionFilter = 1,
+	.tapRadius = 10,
+	.tapTimeout = 300,
+	.doubleTapRadius = 30,
+	.doubleTapTimeout = 300,
+	.longPressTimeout = 500,
+	.flickMinVelocity = 500,
+	.filterMinCutoff = 1.0,
+	.filterBeta = 0.007,
+	.filterDerivativeCutoff = 1.0,
+	.palmWeightThreshold = 200,
+	.edgeRejectWidth = 32,
+	.edgeSwipeZone = 2,
+	.edgeSwipeDistance = 5,
+	.edgeSwipeTimeout = 500
+};
+
+static bool fuzz_initialized = false;
+
+// one spare event behind the capacity to catch writes past it
+static input_event_t fuzz_events[FUZZ_MAX_CAPACITY + 1];
+
+static void check_output(int capacity, int numEvents, int frameEvents)
+{
+	const uint8_t *p;
+	size_t i;
+
+	FUZZ_CHECK(numEvents >= 0);
+	FUZZ_CHECK(numEvents <= capacity);
+	FUZZ_CHECK(frameEvents <= 2 * FUZZ_MAX_FINGERS * MAX_EVENTS_PER_FINGER +
+	           MAX_EVENTS_MULTI_FINGER + 1);
+
+	p = (const uint8_t *) &fuzz_events[capacity];
+
+	for (i = 0; i < (FUZZ_MAX_CAPACITY + 1 - capacity) * sizeof(input_event_t);
+	        i++)
+	{
+		FUZZ_CHECK(p[i] == FUZZ_GUARD);
+	}
+
+	FUZZ_CHECK(g_list_length(sFingers) + g_queue_get_length(&availableFingers) ==
+	           2 * FUZZ_MAX_FINGERS);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	time_stamp_t now = { { 0, 0 } };
+	size_t pos = 0;
+
+	if (!fuzz_initialized)
+	{
+		init_gesture_state_machine(&fuzz_settings, FUZZ_MAX_FINGERS);
+		gesture_state_machine_set_screen_size(FUZZ_COORD_MASK + 1,
+		                                      FUZZ_COORD_MASK + 1);
+		fuzz_initialized = true;
+	}
+
+	while (pos + 3 <= size)
+	{
+		int x[FUZZ_MAX_INPUT_FINGERS], y[FUZZ_MAX_INPUT_FINGERS];
+		int weight[FUZZ_MAX_INPUT_FINGERS];
+		int fingers = data[pos] % (FUZZ_MAX_INPUT_FINGERS + 1);
+		int step = data[pos + 1];
+		int capacity = data[pos + 2] % (FUZZ_MAX_CAPACITY + 1);
+		int numEvents = -1;
+		int frameEvents;
+		int i;
+
+		pos += 3;
+
+		if (pos + fingers * 5 > size)
+		{
+			break;
+		}
+
+		for (i = 0; i < fingers; i++, pos += 5)
+		{
+			x[i] = (data[pos] | data[pos + 1] << 8) & FUZZ_COORD_MASK;
+			y[i] = (data[pos + 2] | data[pos + 3] << 8) & FUZZ_COORD_MASK;
+			weight[i] = data[pos + 4];
+		}
+
+		now.time.tv_nsec += step * 1000000L;
+
+		if (now.time.tv_nsec >= 1000000000L)
+		{
+			now.time.tv_sec++;
+			now.time.tv_nsec -= 1000000000L;
+		}
+
+		memset(fuzz_events, FUZZ_GUARD, sizeof(fuzz_events));
+
+		// an empty frame with a long step stands for a finger held still
+		if (fingers == 0 && step > 200)
+		{
+			gesture_state_machine_timeout(&now, fuzz_events, capacity, &numEvents);
+		}
+		else
+		{
+			gesture_state_machine(x, y, weight, fingers, &now, fuzz_events, capacity,
+			                      &numEvents);
+		}
+
+		frameEvents = sOut.frameEvents;
+		check_output(capacity, numEvents, frameEvents);
+
+		// fetch what was deferred, as the module does before reading input
+		while (gesture_state_machine_pending())
+		{
+			int before = gesture_state_machine_pending();
+
+			memset(fuzz_events, FUZZ_GUARD, sizeof(fuzz_events));
+			gesture_state_machine_resume(fuzz_events, FUZZ_MAX_CAPACITY, &numEvents);
+			check_output(FUZZ_MAX_CAPACITY, numEvents, 0);
+			FUZZ_CHECK(gesture_state_machine_pending() < before);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Driver for the fuzz targets when they are not linked against libFuzzer,
+// e.g. for AFL or to replay a crashing input: runs the target once on the
+// file given on the command line, or on stdin.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define MAX_INPUT_SIZE  (1024 * 1024)
+
+int main(int argc, char **argv)
+{
+	FILE *input = stdin;
+	uint8_t *data;
+	size_t size;
+
+	if (argc > 1)
+	{
+		input = fopen(argv[1], "rb");
+
+		if (NULL == input)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+	}
+
+	data = malloc(MAX_INPUT_SIZE);
+
+	if (NULL == data)
+	{
+		return 1;
+	}
+
+	size = fread(data, 1, MAX_INPUT_SIZE, input);
+	LLVMFuzzerTestOneInput(data, size);
+
+	free(data);
+
+	if (input != stdin)
+	{
+		fclose(input);
+	}
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+//
+// Fuzz target for the touchpanel event path.
+//
+// The input is a stream of raw input_event_t structs. It is written to a pipe
+// that stands in for the evdev device, and touchpanel_get_event() is called
+// until it has been consumed, so every event goes through read_input_event(),
+// handle_new_event() and the gesture engine.
+//
+// Checked after every call:
+//  - the event list never claims more events than touchpanel_event_list.input
+//    can hold, and never reads past what was filled
+//  - no frame in the event list has more events than the engine can produce
+//    for the fingers it tracks
+//  - every finger is either in sFingers or in availableFingers
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_warn
+#define nyx_warn(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+nyx_error_t nyx_module_register_method(nyx_instance_t instance,
+                                       nyx_device_t *device_in_ptr,
+                                       module_method_t method,
+                                       const char *symbol_str)
+{
+	return NYX_ERROR_NONE;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../touchpanel.c"
+#include "../touchpanel_common.c"
+#include "../touchpanel_settings.c"
+#include "../touchpanel_trace.c"
+#include "../touchpanel_filter.c"
+#include "../touchpanel_gestures.c"
+#include "../touchpanel_ring.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+#define FUZZ_CHECK(condition)                                          \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: invariant violated: %s\n",               \
+              __FILE__, __LINE__, #condition);                         \
+      abort();                                                         \
+    }                                                                  \
+  } while(0)
+
+// the module tracks a single finger, see init_touchpanel()
+#define FUZZ_MAX_FINGERS    1
+
+// stay well below the pipe capacity so writing never blocks
+#define FUZZ_MAX_EVENTS     1024
+
+static touchpanel_device_t *fuzz_device;
+static int fuzz_pipe[2] = { -1, -1 };
+
+static void fuzz_init(void)
+{
+	fuzz_device = calloc(sizeof(touchpanel_device_t), 1);
+	FUZZ_CHECK(NULL != fuzz_device);
+
+	FUZZ_CHECK(pipe2(fuzz_pipe, O_NONBLOCK) == 0);
+	touchpanel_event_fd = fuzz_pipe[0];
+
+	scaleX = 1.0f;
+	scaleY = 1.0f;
+	init_gesture_state_machine(&sGeneralSettings, FUZZ_MAX_FINGERS);
+	FUZZ_CHECK(init_event_source() == 0);
+}
+
+static void check_invariants(void)
+{
+	size_t filled = touchpanel_event_list.input_filled / sizeof(input_event_t);
+	int maxFrameEvents = 2 * FUZZ_MAX_FINGERS * MAX_EVENTS_PER_FINGER +
+	                     MAX_EVENTS_MULTI_FINGER + 1;
+	struct pollfd queue = { .fd = queue_signal_fd, .events = POLLIN };
+	bool queued = touchpanel_event_list.input_read <
+	              touchpanel_event_list.input_filled || gesture_state_machine_pending() ||
+	              touchpanel_raw.next < touchpanel_raw.count;
+	int frameEvents = 0;
+	size_t i;
+
+	// the event source must wake the caller for everything still queued
+	FUZZ_CHECK(poll(&queue, 1, 0) == (queued ? 1 : 0));
+
+	FUZZ_CHECK(touchpanel_event_list.input_filled <=
+	           sizeof(touchpanel_event_list.input));
+	FUZZ_CHECK(touchpanel_event_list.input_read <=
+	           touchpanel_event_list.input_filled);
+
+	for (i = 0; i < filled; i++)
+	{
+		frameEvents++;
+		FUZZ_CHECK(frameEvents <= maxFrameEvents);
+
+		if (EV_SYN == touchpanel_event_list.input[i].type)
+		{
+			frameEvents = 0;
+		}
+	}
+
+	FUZZ_CHECK(g_list_length(sFingers) + g_queue_get_length(&availableFingers) ==
+	           2 * FUZZ_MAX_FINGERS);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	size_t numEvents = MIN(size / sizeof(input_event_t), FUZZ_MAX_EVENTS);
+	size_t calls;
+	input_event_t drain[64];
+
+	if (NULL == fuzz_device)
+	{
+		fuzz_init();
+	}
+
+	// cover both modes, the switch takes effect between touches
+	FUZZ_CHECK(touchpanel_set_mode((nyx_device_t *) fuzz_device,
+	                               (size & 1) ? TOUCHPANEL_MODE_RAW :
+	                               TOUCHPANEL_MODE_GESTURES) == NYX_ERROR_NONE);
+
+	// the kernel only ever hands out whole events
+	if (numEvents)
+	{
+		FUZZ_CHECK(write(fuzz_pipe[1], data, numEvents * sizeof(input_event_t)) ==
+		           (ssize_t)(numEvents * sizeof(input_event_t)));
+	}
+
+	// every call either handles input up to the end of a frame or delivers
+	// one frame from the list
+	for (calls = 0; calls < 4 * (numEvents + 1) + MAX_HIDD_EVENTS; calls++)
+	{
+		nyx_event_t *event = NULL;
+
+		FUZZ_CHECK(touchpanel_get_event((nyx_device_t *) fuzz_device,
+		                                &event) == NYX_ERROR_NONE);
+		check_invariants();
+
+		if (NULL != event)
+		{
+			nyx_event_touchpanel_t *touch_event = (nyx_event_touchpanel_t *) event;
+
+			FUZZ_CHECK(touch_event->item_count >= 0);
+			FUZZ_CHECK(touch_event->item_count <= NYX_MAX_TOUCH_EVENTS);
+			touchpanel_release_event((nyx_device_t *) fuzz_device, event);
+		}
+	}
+
+	// leave nothing behind for the next input
+	while (read(fuzz_pipe[0], drain, sizeof(drain)) > 0)
+	{
+	}
+
+	touchpanel_raw.count = 0;
+	touchpanel_raw.next = 0;
+
+	return 0;
+}
@@ -0,0 +1,985 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <glib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// Provide missing g_test macros if they are not defined in this version.
+//
+// We can't simply back-port the real definitions from glib as that would
+// would change the license for this component.
+//
+
+#ifndef g_assert_true
+#define g_assert_true(X) g_assert((X))
+#endif
+
+#ifndef g_assert_false
+#define g_assert_false(X) g_assert(!(X))
+#endif
+
+#ifndef g_assert_nonnull
+#define g_assert_nonnull(X) g_assert((X) != NULL)
+#endif
+
+#ifndef g_assert_null
+#define g_assert_null(X) g_assert((X) == NULL)
+#endif
+
+//
+// Pull in the relevant nyx headers. That way we can redefine macros
+// if necessary (e.g. for logging) and the anti-recursion in the headers
+// will let our redefinitions leak through into the UUT.
+//
+#include <nyx/nyx_module.h>
+#include <nyx/module/nyx_utils.h>
+#include <nyx/module/nyx_log.h>
+
+//
+// Mock out all the calls to nyx-lib
+//
+#undef nyx_info
+#define nyx_info(m, args...) {}
+#undef nyx_debug
+#define nyx_debug(m, args...) {}
+#undef nyx_warn
+#define nyx_warn(m, args...) {}
+#undef nyx_error
+#define nyx_error(m, args...) {}
+
+nyx_error_t nyx_module_register_method(nyx_instance_t instance,
+                                       nyx_device_t *device_in_ptr,
+                                       module_method_t method,
+                                       const char *symbol_str)
+{
+	return NYX_ERROR_NONE;
+}
+
+//
+// Keep the UUT away from the settings of the machine the tests run on, the
+// tests that need a settings file write their own.
+//
+static gchar *settings_path;
+
+#undef TOUCHPANEL_SETTINGS_FILE
+#define TOUCHPANEL_SETTINGS_FILE settings_path
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Pull in the unit under test
+#include "../touchpanel.c"
+#include "../touchpanel_common.c"
+#include "../touchpanel_settings.c"
+#include "../touchpanel_trace.c"
+#include "../touchpanel_filter.c"
+#include "../touchpanel_gestures.c"
+#include "../touchpanel_ring.c"
+
+//*****************************************************************************
+//*****************************************************************************
+
+//
+// The gesture tests drive the engine with scripted frames, time stamped in ms
+// since an arbitrary start, and look at the touch items the module turns its
+// output into. They use the following fixture, which starts every test from
+// the built-in settings.
+//
+// For ease, these tests can be added using the ADD_GESTURETEST macro
+//
+
+#define SCREEN_WIDTH        1920
+#define SCREEN_HEIGHT       1080
+#define MAX_TEST_FINGERS    2
+
+typedef struct
+{
+	general_settings_t settings;
+	touchpanel_device_t device;     /**< builds the touch items */
+	input_event_t events[MAX_HIDD_EVENTS];
+	int numEvents;
+} gesture_test_fixture;
+
+static void gesture_test_setup(gesture_test_fixture *fixture,
+                               gconstpointer unused)
+{
+	memset(fixture, 0, sizeof(*fixture));
+	fixture->settings = sGeneralSettings;
+	fixture->settings.palmWeightThreshold = 0;
+	init_gesture_state_machine(&fixture->settings, MAX_TEST_FINGERS);
+	gesture_state_machine_set_screen_size(SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+static void gesture_test_teardown(gesture_test_fixture *fixture,
+                                  gconstpointer unused)
+{
+	deinit_gesture_state_machine();
+	gesture_state_machine_set_screen_size(0, 0);
+	free(fixture->device.current_event_ptr);
+}
+
+#define ADD_GESTURETEST(path, func) g_test_add(path, gesture_test_fixture, NULL, gesture_test_setup, func, gesture_test_teardown)
+
+static time_stamp_t test_time(int ms)
+{
+	time_stamp_t time;
+
+	time.time.tv_sec = ms / 1000;
+	time.time.tv_nsec = (ms % 1000) * 1000000L;
+
+	return time;
+}
+
+//
+// Turn what the engine emitted into the touch event the module would report
+// for it, or NULL if it emitted nothing. Free it with free().
+//
+static nyx_event_touchpanel_t *frame_event(gesture_test_fixture *fixture)
+{
+	nyx_event_t *event = NULL;
+	int i;
+
+	for (i = 0; i < fixture->numEvents; i++)
+	{
+		if (NULL == fixture->device.current_event_ptr)
+		{
+			fixture->device.current_event_ptr = touch_event_create();
+		}
+
+		event = touch_event_process(&fixture->device, &fixture->events[i]);
+	}
+
+	g_assert_true(0 == fixture->numEvents || NULL != event);
+
+	return (nyx_event_touchpanel_t *) event;
+}
+
+//
+// One frame of numFingers contacts at coords, all of weight 1 unless
+// pWeights says otherwise.
+//
+static nyx_event_touchpanel_t *run_frame(gesture_test_fixture *fixture, int ms,
+        int numFingers, const int coords[][2], const int *pWeights)
+{
+	int x[MAX_TEST_FINGERS], y[MAX_TEST_FINGERS], weight[MAX_TEST_FINGERS];
+	time_stamp_t time = test_time(ms);
+	int i;
+
+	g_assert_true(numFingers <= MAX_TEST_FINGERS);
+
+	for (i = 0; i < numFingers; i++)
+	{
+		x[i] = coords[i][0];
+		y[i] = coords[i][1];
+		weight[i] = pWeights ? pWeights[i] : 1;
+	}
+
+	g_assert_true(gesture_state_machine(x, y, weight, numFingers, &time,
+	                                    fixture->events, MAX_HIDD_EVENTS,
+	                                    &fixture->numEvents) == GESTURE_EMIT_OK);
+
+	return frame_event(fixture);
+}
+
+// a single finger at x,y, or none if x is negative
+static nyx_event_touchpanel_t *run_finger(gesture_test_fixture *fixture,
+        int ms, int x, int y)
+{
+	const int coords[1][2] = { { x, y } };
+
+	return run_frame(fixture, ms, x < 0 ? 0 : 1, coords, NULL);
+}
+
+static nyx_event_touchpanel_t *run_timeout(gesture_test_fixture *fixture,
+        int ms)
+{
+	time_stamp_t time = test_time(ms);
+
+	g_assert_true(gesture_state_machine_timeout(&time, fixture->events,
+	              MAX_HIDD_EVENTS, &fixture->numEvents) == GESTURE_EMIT_OK);
+
+	return frame_event(fixture);
+}
+
+// the item of event that reports gestureKey, NULL if there is none
+static nyx_touchpanel_event_item_t *find_item(nyx_event_touchpanel_t *event,
+        int32_t gestureKey)
+{
+	int i;
+
+	for (i = 0; NULL != event && i < event->item_count; i++)
+	{
+		if (event->item_array[i].gestureKey == gestureKey)
+		{
+			return &event->item_array[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int count_items(nyx_event_touchpanel_t *event,
+                       nyx_touchpanel_state_t state)
+{
+	int i, count = 0;
+
+	for (i = 0; NULL != event && i < event->item_count; i++)
+	{
+		count += event->item_array[i].state == state;
+	}
+
+	return count;
+}
+
+//
+// The module tests feed raw input through a pipe that stands in for the
+// device, like the kernel would report it, and fetch the touch events with
+// touchpanel_get_event(). They use the following fixture.
+//
+// For ease, these tests can be added using the ADD_MODULETEST macro
+//
+
+typedef struct
+{
+	nyx_device_t *fixture_device;
+	int pipe[2];
+	general_settings_t settings;    /**< to restore afterwards */
+} module_test_fixture;
+
+static void module_test_setup(module_test_fixture *fixture,
+                              gconstpointer unused)
+{
+	memset(fixture, 0, sizeof(*fixture));
+	fixture->settings = sGeneralSettings;
+	fixture->fixture_device = calloc(sizeof(touchpanel_device_t), 1);
+	g_assert_nonnull(fixture->fixture_device);
+
+	g_assert_true(pipe2(fixture->pipe, O_NONBLOCK) == 0);
+	touchpanel_event_fd = fixture->pipe[0];
+	scaleX = 1.0f;
+	scaleY = 1.0f;
+
+	init_gesture_state_machine(&sGeneralSettings, 1);
+	g_assert_true(init_event_source() == 0);
+}
+
+static void module_test_teardown(module_test_fixture *fixture,
+                                 gconstpointer unused)
+{
+	touchpanel_device_t *touch_device = (touchpanel_device_t *)
+	                                    fixture->fixture_device;
+
+	free(touch_device->current_event_ptr);
+	free(touch_device);
+	deinit_gesture_state_machine();
+	deinit_event_source();
+
+	close(fixture->pipe[0]);
+	close(fixture->pipe[1]);
+	touchpanel_event_fd = -1;
+
+	touchpanel_event_list.input_filled = 0;
+	touchpanel_event_list.input_read = 0;
+	touchpanel_raw.count = 0;
+	touchpanel_raw.next = 0;
+	touchpanel_raw.full = false;
+
+	if (settings_watch_fd >= 0)
+	{
+		close(settings_watch_fd);
+		settings_watch_fd = -1;
+	}
+
+	sGeneralSettings = fixture->settings;
+}
+
+#define ADD_MODULETEST(path, func) g_test_add(path, module_test_fixture, NULL, module_test_setup, func, module_test_teardown)
+
+static void write_event(module_test_fixture *fixture, int ms, uint16_t type,
+                        uint16_t code, int32_t value)
+{
+	input_event_t event;
+
+	memset(&event, 0, sizeof(event));
+	event.time.tv_sec = ms / 1000;
+	event.time.tv_usec = (ms % 1000) * 1000;
+	event.type = type;
+	event.code = code;
+	event.value = value;
+
+	g_assert_true(write(fixture->pipe[1], &event, sizeof(event)) == sizeof(event));
+}
+
+// a report of the contact at x,y, with BTN_TOUCH if touch is 0 or 1
+static void write_contact(module_test_fixture *fixture, int ms, int x, int y,
+                          int touch)
+{
+	write_event(fixture, ms, EV_ABS, ABS_X, x);
+	write_event(fixture, ms, EV_ABS, ABS_Y, y);
+
+	if (touch >= 0)
+	{
+		write_event(fixture, ms, EV_KEY, BTN_TOUCH, touch);
+	}
+
+	write_event(fixture, ms, EV_SYN, SYN_REPORT, 0);
+}
+
+//
+// The next touch event, or NULL once the input is used up. Release it with
+// touchpanel_release_event().
+//
+static nyx_event_touchpanel_t *next_event(module_test_fixture *fixture)
+{
+	int calls;
+
+	for (calls = 0; calls < (int)MAX_HIDD_EVENTS; calls++)
+	{
+		nyx_event_t *event = NULL;
+
+		g_assert_true(touchpanel_get_event(fixture->fixture_device,
+		                                   &event) == NYX_ERROR_NONE);
+
+		if (NULL != event)
+		{
+			return (nyx_event_touchpanel_t *) event;
+		}
+
+		if (!touchpanel_input_pending())
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+// a file of its own in the temp dir, copies of the test may run side by side
+static gchar *temp_file(const char *pName)
+{
+	gchar *name = g_strdup_printf("%d-%s", (int) getpid(), pName);
+	gchar *path = g_build_filename(g_get_tmp_dir(), name, NULL);
+
+	g_free(name);
+	return path;
+}
+
+static void write_file(const char *pPath, const char *pContents)
+{
+	g_assert_true(g_file_set_contents(pPath, pContents, -1, NULL));
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+//
+// A finger put down and lifted in place, quickly, is a tap. A second one
+// close by and soon after is a double tap, a third one a tap again.
+//
+static void test_tap(gesture_test_fixture *fixture, gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	nyx_touchpanel_event_item_t *item;
+
+	event = run_finger(fixture, 1000, 500, 500);
+	g_assert_nonnull(event);
+	g_assert_cmpint(event->item_count, ==, 1);
+	g_assert_cmpint(event->item_array[0].state, ==, NYX_TOUCHPANEL_STATE_DOWN);
+	g_assert_cmpint(event->item_array[0].x, ==, 500);
+	g_assert_cmpint(event->item_array[0].gestureKey, ==, GESTURE_KEY_NONE);
+	free(event);
+
+	free(run_finger(fixture, 1050, 503, 498));
+	event = run_finger(fixture, 1100, -1, -1);
+	item = find_item(event, GESTURE_KEY_TAP);
+	g_assert_nonnull(item);
+	g_assert_cmpint(item->state, ==, NYX_TOUCHPANEL_STATE_UP);
+	g_assert_cmpint(item->finger % 1000, ==, 0);
+	free(event);
+
+	free(run_finger(fixture, 1200, 510, 505));
+	event = run_finger(fixture, 1250, -1, -1);
+	g_assert_nonnull(find_item(event, GESTURE_KEY_DOUBLE_TAP));
+	g_assert_null(find_item(event, GESTURE_KEY_TAP));
+	free(event);
+
+	free(run_finger(fixture, 1300, 510, 505));
+	event = run_finger(fixture, 1350, -1, -1);
+	g_assert_nonnull(find_item(event, GESTURE_KEY_TAP));
+	free(event);
+
+	// too far from the tap before
+	free(run_finger(fixture, 1400, 900, 505));
+	event = run_finger(fixture, 1450, -1, -1);
+	g_assert_nonnull(find_item(event, GESTURE_KEY_TAP));
+	free(event);
+
+	// held down for too long
+	free(run_finger(fixture, 2000, 900, 505));
+	free(run_finger(fixture, 2400, 900, 505));
+	event = run_finger(fixture, 2450, -1, -1);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_UP), ==, 1);
+	g_assert_null(find_item(event, GESTURE_KEY_TAP));
+	g_assert_null(find_item(event, GESTURE_KEY_DOUBLE_TAP));
+	free(event);
+}
+
+//
+// A finger held still is reported as a long press once LongPressTimeout
+// has passed, from the gesture timer, and is no tap when it is lifted.
+//
+static void test_long_press(gesture_test_fixture *fixture,
+                            gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	time_stamp_t time;
+
+	free(run_finger(fixture, 1000, 500, 500));
+
+	time = test_time(1000);
+	g_assert_cmpint(gesture_state_machine_get_timeout(&time), ==, 500);
+	time = test_time(1400);
+	g_assert_cmpint(gesture_state_machine_get_timeout(&time), ==, 100);
+
+	event = run_timeout(fixture, 1300);
+	g_assert_null(event);
+
+	event = run_timeout(fixture, 1500);
+	g_assert_nonnull(find_item(event, GESTURE_KEY_LONG_PRESS));
+	free(event);
+
+	time = test_time(1600);
+	g_assert_cmpint(gesture_state_machine_get_timeout(&time), ==, -1);
+
+	event = run_finger(fixture, 1700, -1, -1);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_UP), ==, 1);
+	g_assert_null(find_item(event, GESTURE_KEY_TAP));
+	free(event);
+
+	// moving out of the tap radius cancels it
+	free(run_finger(fixture, 2000, 500, 500));
+	free(run_finger(fixture, 2100, 560, 500));
+	time = test_time(2100);
+	g_assert_cmpint(gesture_state_machine_get_timeout(&time), ==, -1);
+	g_assert_null(run_timeout(fixture, 2600));
+	free(run_finger(fixture, 2700, -1, -1));
+}
+
+//
+// A finger lifted while moving fast is a flick with its velocity, one that
+// slows down first is not.
+//
+static void test_flick(gesture_test_fixture *fixture, gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	nyx_touchpanel_event_item_t *item;
+	int i;
+
+	for (i = 0; i <= 5; i++)
+	{
+		free(run_finger(fixture, 1000 + i * 8, 100 + i * 40, 500));
+	}
+
+	event = run_finger(fixture, 1048, -1, -1);
+	item = find_item(event, GESTURE_KEY_FLICK);
+	g_assert_nonnull(item);
+	g_assert_cmpint(item->xVelocity, ==, 5000);
+	g_assert_cmpint(item->yVelocity, ==, 0);
+	free(event);
+
+	for (i = 0; i <= 5; i++)
+	{
+		free(run_finger(fixture, 2000 + i * 100, 100 + i * 20, 500));
+	}
+
+	event = run_finger(fixture, 2600, -1, -1);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_UP), ==, 1);
+	g_assert_null(find_item(event, GESTURE_KEY_FLICK));
+	free(event);
+}
+
+//
+// Two fingers report pinch, rotate and pan items of their own, and neither
+// is a tap when they are lifted.
+//
+static void test_two_fingers(gesture_test_fixture *fixture,
+                             gconstpointer unused)
+{
+	const int start[2][2] = { { 400, 500 }, { 600, 500 } };
+	const int spread[2][2] = { { 300, 500 }, { 700, 500 } };
+	const int turned[2][2] = { { 303, 465 }, { 697, 535 } };
+	const int moved[2][2] = { { 353, 465 }, { 747, 535 } };
+	nyx_event_touchpanel_t *event;
+	nyx_touchpanel_event_item_t *item;
+
+	event = run_frame(fixture, 1000, 2, start, NULL);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_DOWN), ==, 2);
+	g_assert_null(find_item(event, GESTURE_KEY_PINCH));
+	free(event);
+
+	event = run_frame(fixture, 1010, 2, spread, NULL);
+	item = find_item(event, GESTURE_KEY_PINCH);
+	g_assert_nonnull(item);
+	g_assert_cmpint(item->finger, ==, TOUCHPANEL_GESTURE_ITEM_FINGER);
+	g_assert_cmpint(item->x, ==, 500);
+	g_assert_cmpint(item->y, ==, 500);
+	g_assert_cmpfloat(item->weight, ==, 2.0);
+	g_assert_null(find_item(event, GESTURE_KEY_ROTATE));
+	g_assert_null(find_item(event, GESTURE_KEY_PAN));
+	free(event);
+
+	event = run_frame(fixture, 1020, 2, turned, NULL);
+	item = find_item(event, GESTURE_KEY_ROTATE);
+	g_assert_nonnull(item);
+	g_assert_cmpfloat(item->weight, >, 9.5);
+	g_assert_cmpfloat(item->weight, <, 10.5);
+	g_assert_null(find_item(event, GESTURE_KEY_PAN));
+	free(event);
+
+	event = run_frame(fixture, 1030, 2, moved, NULL);
+	item = find_item(event, GESTURE_KEY_PAN);
+	g_assert_nonnull(item);
+	g_assert_cmpint(item->x, ==, 550);
+	g_assert_cmpint(item->xVelocity, ==, 50);
+	g_assert_cmpint(item->yVelocity, ==, 0);
+	g_assert_null(find_item(event, GESTURE_KEY_PINCH));
+	g_assert_null(find_item(event, GESTURE_KEY_ROTATE));
+	free(event);
+
+	event = run_frame(fixture, 1040, 0, NULL, NULL);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_UP), ==, 2);
+	g_assert_null(find_item(event, GESTURE_KEY_TAP));
+	free(event);
+}
+
+//
+// Contacts at least Rejection/PalmWeight heavy are dropped, and release a
+// finger they land on. New contacts at the screen edge are dropped while
+// another finger is down, a lone one is kept.
+//
+static void test_rejection(gesture_test_fixture *fixture,
+                           gconstpointer unused)
+{
+	const int palm[1] = { 200 };
+	const int finger[1] = { 20 };
+	const int coords[1][2] = { { 500, 500 } };
+	const int withEdge[2][2] = { { 500, 500 }, { 5, 500 } };
+	nyx_event_touchpanel_t *event;
+
+	fixture->settings.palmWeightThreshold = 150;
+	fixture->settings.edgeRejectWidth = 20;
+
+	g_assert_null(run_frame(fixture, 1000, 1, coords, palm));
+	g_assert_null(run_frame(fixture, 1010, 0, NULL, NULL));
+
+	event = run_frame(fixture, 1020, 1, coords, finger);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_DOWN), ==, 1);
+	free(event);
+
+	event = run_frame(fixture, 1030, 1, coords, palm);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_UP), ==, 1);
+	free(event);
+	g_assert_null(run_frame(fixture, 1040, 0, NULL, NULL));
+
+	free(run_finger(fixture, 2000, 500, 500));
+	event = run_frame(fixture, 2010, 2, withEdge, NULL);
+	g_assert_nonnull(event);
+	g_assert_cmpint(event->item_count, ==, 1);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_DOWN), ==, 0);
+	free(event);
+	free(run_finger(fixture, 2020, -1, -1));
+
+	event = run_finger(fixture, 3000, 5, 500);
+	g_assert_cmpint(count_items(event, NYX_TOUCHPANEL_STATE_DOWN), ==, 1);
+	free(event);
+	free(run_finger(fixture, 3010, -1, -1));
+}
+
+//
+// With EdgeSwipe/Zone set, a finger that goes down at an edge and moves away
+// from it far enough and in time is an edge swipe, reported once in an item
+// after the one of the finger. EdgeSwipe/Zone is off by default.
+//
+static void test_edge_swipe(gesture_test_fixture *fixture,
+                            gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	nyx_touchpanel_event_item_t *item;
+
+	// off
+	free(run_finger(fixture, 1000, 10, 540));
+	event = run_finger(fixture, 1100, 150, 545);
+	g_assert_null(find_item(event, GESTURE_KEY_EDGE_SWIPE_LEFT));
+	free(event);
+	free(run_finger(fixture, 1200, -1, -1));
+
+	fixture->settings.edgeSwipeZone = 2;
+
+	free(run_finger(fixture, 2000, 10, 540));
+	event = run_finger(fixture, 2050, 60, 540);
+	g_assert_null(find_item(event, GESTURE_KEY_EDGE_SWIPE_LEFT));
+	free(event);
+
+	event = run_finger(fixture, 2100, 150, 545);
+	item = find_item(event, GESTURE_KEY_EDGE_SWIPE_LEFT);
+	g_assert_nonnull(item);
+	g_assert_true(item == &event->item_array[event->item_count - 1]);
+	g_assert_cmpint(item->finger, ==, TOUCHPANEL_GESTURE_ITEM_FINGER);
+	g_assert_cmpint(item->x, ==, 150);
+	g_assert_cmpint(item->xVelocity, >, 0);
+	free(event);
+
+	event = run_finger(fixture, 2150, 300, 545);
+	g_assert_null(find_item(event, GESTURE_KEY_EDGE_SWIPE_LEFT));
+	free(event);
+
+	event = run_finger(fixture, 2200, -1, -1);
+	g_assert_null(find_item(event, GESTURE_KEY_FLICK));
+	free(event);
+
+	// too slow
+	free(run_finger(fixture, 3000, 1910, 540));
+	event = run_finger(fixture, 3600, 1700, 540);
+	g_assert_null(find_item(event, GESTURE_KEY_EDGE_SWIPE_RIGHT));
+	free(event);
+	free(run_finger(fixture, 3700, -1, -1));
+}
+
+//
+// The 1 euro filter passes the first sample as it is, smooths jitter of a
+// finger held still, and catches up with a finger that moved.
+//
+static void test_position_filter(gesture_test_fixture *fixture,
+                                 gconstpointer unused)
+{
+	one_euro_filter_t filter;
+	time_stamp_t time;
+	double value = 0.0;
+	int i;
+
+	one_euro_filter_reset(&filter);
+	time = test_time(1000);
+	g_assert_cmpfloat(one_euro_filter_apply(&filter, 100.0, &time,
+	                                        &fixture->settings), ==, 100.0);
+
+	for (i = 1; i <= 100; i++)
+	{
+		time = test_time(1000 + i * 8);
+		value = one_euro_filter_apply(&filter, i & 1 ? 104.0 : 96.0, &time,
+		                              &fixture->settings);
+		g_assert_cmpfloat(fabs(value - 100.0), <, 1.0);
+	}
+
+	for (i = 1; i <= 250; i++)
+	{
+		time = test_time(2000 + i * 8);
+		value = one_euro_filter_apply(&filter, 500.0, &time, &fixture->settings);
+	}
+
+	g_assert_cmpfloat(fabs(value - 500.0), <, 1.0);
+
+	// and the engine reports the smoothed coordinates
+	fixture->settings.positionFilter = 1;
+	free(run_finger(fixture, 3000, 100, 100));
+
+	for (i = 1; i <= 20; i++)
+	{
+		nyx_event_touchpanel_t *event = run_finger(fixture, 3000 + i * 8,
+		                                i & 1 ? 104 : 96, 100);
+
+		g_assert_cmpint(abs(event->item_array[0].x - 100), <=, 1);
+		free(event);
+	}
+
+	free(run_finger(fixture, 3200, -1, -1));
+}
+
+//
+// Settings files override the keys they have, and nothing if one of them is
+// invalid.
+//
+static void test_settings_load()
+{
+	general_settings_t settings = sGeneralSettings;
+	gchar *path = temp_file("settings.conf");
+
+	g_assert_cmpint(load_general_settings("/nonexistent/touchpanel.conf",
+	                                      &settings), ==, -1);
+
+	write_file(path, "[Gestures]\nTapRadius=20\n[Filter]\nBeta=0.5\n");
+	g_assert_cmpint(load_general_settings(path, &settings), ==, 0);
+	g_assert_cmpint(settings.tapRadius, ==, 20);
+	g_assert_cmpfloat(settings.filterBeta, ==, 0.5);
+	g_assert_cmpint(settings.tapTimeout, ==, sGeneralSettings.tapTimeout);
+
+	write_file(path, "[Gestures]\nTapRadius=30\nTapTimeout=100000\n");
+	g_assert_cmpint(load_general_settings(path, &settings), ==, -1);
+	g_assert_cmpint(settings.tapRadius, ==, 20);
+
+	write_file(path, "[Gestures]\nTapRadius=wide\n");
+	g_assert_cmpint(load_general_settings(path, &settings), ==, -1);
+	g_assert_cmpint(settings.tapRadius, ==, 20);
+
+	unlink(path);
+	g_free(path);
+}
+
+//
+// A settings file written while the module runs is picked up before the
+// next input is handled, one with errors is not.
+//
+static void test_settings_reload(module_test_fixture *fixture,
+                                 gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+
+	unlink(settings_path);
+	settings_watch_fd = watch_general_settings(settings_path);
+	g_assert_cmpint(settings_watch_fd, >=, 0);
+
+	write_file(settings_path, "[Gestures]\nTapRadius=42\n[General]\n"
+	           "CoordBufSize=10\n");
+	write_contact(fixture, 1000, 100, 100, 1);
+	event = next_event(fixture);
+	g_assert_nonnull(event);
+	touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	g_assert_cmpint(sGeneralSettings.tapRadius, ==, 42);
+	g_assert_cmpint(sGeneralSettings.coordBufSize, ==, 10);
+
+	write_file(settings_path, "[Gestures]\nTapRadius=-1\n");
+	write_contact(fixture, 1010, 100, 100, 0);
+
+	while (NULL != (event = next_event(fixture)))
+	{
+		touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	}
+
+	g_assert_cmpint(sGeneralSettings.tapRadius, ==, 42);
+	g_assert_false(general_settings_changed(settings_watch_fd, settings_path));
+
+	unlink(settings_path);
+}
+
+//
+// The ring takes whole frames or nothing, and hands them out in order across
+// the wrap around.
+//
+static void test_event_ring()
+{
+	event_ring_t ring;
+	input_event_t events[3];
+	int i;
+
+	g_assert_cmpint(event_ring_init(&ring, 6), ==, -1);
+	g_assert_cmpint(event_ring_init(&ring, 4), ==, 0);
+	g_assert_null(event_ring_peek(&ring));
+
+	for (i = 0; i < 3; i++)
+	{
+		memset(&events[i], 0, sizeof(events[i]));
+		events[i].value = i;
+	}
+
+	g_assert_true(event_ring_push(&ring, events, 3));
+	g_assert_cmpuint(event_ring_count(&ring), ==, 3);
+	g_assert_cmpuint(event_ring_space(&ring), ==, 1);
+	g_assert_false(event_ring_push(&ring, events, 2));
+	g_assert_cmpuint(event_ring_count(&ring), ==, 3);
+
+	for (i = 0; i < 2; i++)
+	{
+		g_assert_cmpint(event_ring_peek(&ring)->value, ==, i);
+		event_ring_pop(&ring);
+	}
+
+	g_assert_true(event_ring_push(&ring, events, 3));
+
+	for (i = 0; i < 4; i++)
+	{
+		g_assert_cmpint(event_ring_peek(&ring)->value, ==, (i + 2) % 3);
+		event_ring_pop(&ring);
+	}
+
+	g_assert_null(event_ring_peek(&ring));
+	event_ring_free(&ring);
+}
+
+//
+// With QueuePolicy=1 moves that came in while the consumer fetched the frame
+// before are replaced by the newest of them. Frames that put the finger down
+// or lift it are always delivered, and so is every move with QueuePolicy=0
+// or while the consumer keeps up.
+//
+static void test_queue_policy(module_test_fixture *fixture,
+                              gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	int policy, i, moves;
+
+	for (policy = QUEUE_POLICY_COALESCE; policy >= QUEUE_POLICY_WAIT; policy--)
+	{
+		sGeneralSettings.queuePolicy = policy;
+
+		write_contact(fixture, 1000, 100, 100, 1);
+
+		for (i = 1; i <= 10; i++)
+		{
+			write_contact(fixture, 1000 + i * 10, 100 + i * 20, 100, -1);
+		}
+
+		write_contact(fixture, 1200, 300, 100, 0);
+
+		event = next_event(fixture);
+		g_assert_nonnull(event);
+		g_assert_cmpint(event->item_array[0].state, ==, NYX_TOUCHPANEL_STATE_DOWN);
+		touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+
+		for (moves = 0; NULL != (event = next_event(fixture)); moves++)
+		{
+			if (event->item_array[0].state == NYX_TOUCHPANEL_STATE_UP)
+			{
+				touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+				break;
+			}
+
+			g_assert_cmpint(event->item_array[0].x, ==,
+			                policy == QUEUE_POLICY_COALESCE ? 300 :
+			                MIN(120 + moves * 20, 300));
+			touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+		}
+
+		g_assert_nonnull(event);
+		g_assert_cmpint(moves, ==, policy == QUEUE_POLICY_COALESCE ? 1 : 11);
+		g_assert_null(next_event(fixture));
+	}
+
+	sGeneralSettings.queuePolicy = QUEUE_POLICY_COALESCE;
+	write_contact(fixture, 2000, 100, 100, 1);
+	touchpanel_release_event(fixture->fixture_device,
+	                         (nyx_event_t *) next_event(fixture));
+
+	for (i = 1; i <= 3; i++)
+	{
+		write_contact(fixture, 2000 + i * 10, 100 + i * 20, 100, -1);
+		event = next_event(fixture);
+		g_assert_nonnull(event);
+		g_assert_cmpint(event->item_array[0].x, ==, 100 + i * 20);
+		touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	}
+
+	write_contact(fixture, 2100, 160, 100, 0);
+
+	while (NULL != (event = next_event(fixture)))
+	{
+		touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	}
+}
+
+//
+// Raw mode reports the contact as the device does, with the kernel's time
+// stamps and no gestures. A touch in progress finishes in the mode it started
+// in.
+//
+static void test_raw_mode(module_test_fixture *fixture, gconstpointer unused)
+{
+	nyx_event_touchpanel_t *event;
+	struct timeval time = { 5, 0 };
+	int mode = -1;
+	int32_t finger;
+
+	g_assert_true(touchpanel_set_mode(fixture->fixture_device,
+	                                  2) == NYX_ERROR_INVALID_VALUE);
+	g_assert_true(touchpanel_set_mode(NULL,
+	                                  TOUCHPANEL_MODE_RAW) == NYX_ERROR_INVALID_HANDLE);
+	g_assert_true(touchpanel_set_mode(fixture->fixture_device,
+	                                  TOUCHPANEL_MODE_RAW) == NYX_ERROR_NONE);
+	g_assert_true(touchpanel_get_mode(fixture->fixture_device,
+	                                  &mode) == NYX_ERROR_NONE);
+	g_assert_cmpint(mode, ==, TOUCHPANEL_MODE_RAW);
+
+	write_contact(fixture, 5000, 100, 200, 1);
+	event = next_event(fixture);
+	g_assert_nonnull(event);
+	g_assert_cmpint(event->item_count, ==, 1);
+	g_assert_cmpint(event->item_array[0].state, ==, NYX_TOUCHPANEL_STATE_DOWN);
+	g_assert_cmpint(event->item_array[0].x, ==, 100);
+	g_assert_cmpint(event->item_array[0].y, ==, 200);
+	g_assert_true(event->item_array[0].timestamp == get_ts_tval(&time));
+	finger = event->item_array[0].finger;
+	touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+
+	g_assert_true(touchpanel_set_mode(fixture->fixture_device,
+	                                  TOUCHPANEL_MODE_GESTURES) == NYX_ERROR_NONE);
+
+	write_contact(fixture, 5010, 102, 200, 0);
+	time.tv_usec = 10000;
+	event = next_event(fixture);
+	g_assert_nonnull(event);
+	g_assert_cmpint(event->item_count, ==, 1);
+	g_assert_cmpint(event->item_array[0].state, ==, NYX_TOUCHPANEL_STATE_UP);
+	g_assert_cmpint(event->item_array[0].finger, ==, finger);
+	g_assert_cmpint(event->item_array[0].gestureKey, ==, GESTURE_KEY_NONE);
+	g_assert_true(event->item_array[0].timestamp == get_ts_tval(&time));
+	touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	g_assert_null(next_event(fixture));
+
+	// back to gestures for the next touch, on the time of the module
+	write_contact(fixture, 6000, 100, 200, 1);
+	write_contact(fixture, 6010, 100, 200, 0);
+	time.tv_sec = 6;
+	time.tv_usec = 0;
+	event = next_event(fixture);
+	g_assert_nonnull(event);
+	g_assert_cmpint(event->item_array[0].state, ==, NYX_TOUCHPANEL_STATE_DOWN);
+	g_assert_true(event->item_array[0].timestamp != get_ts_tval(&time));
+	touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+
+	while (NULL != (event = next_event(fixture)))
+	{
+		touchpanel_release_event(fixture->fixture_device, (nyx_event_t *) event);
+	}
+}
+
+//
+// Set-up GLib, then register and run the tests.
+int main(int argc, char **argv)
+{
+	int ret;
+
+	g_test_init(&argc, &argv, NULL);
+	settings_path = temp_file("touchpanel.conf");
+
+	ADD_GESTURETEST("/touchpanel/gestures/tap", test_tap);
+	ADD_GESTURETEST("/touchpanel/gestures/long_press", test_long_press);
+	ADD_GESTURETEST("/touchpanel/gestures/flick", test_flick);
+	ADD_GESTURETEST("/touchpanel/gestures/two_fingers", test_two_fingers);
+	ADD_GESTURETEST("/touchpanel/gestures/rejection", test_rejection);
+	ADD_GESTURETEST("/touchpanel/gestures/edge_swipe", test_edge_swipe);
+	ADD_GESTURETEST("/touchpanel/gestures/position_filter", test_position_filter);
+	g_test_add_func("/touchpanel/config/settings_load", test_settings_load);
+	ADD_MODULETEST("/touchpanel/config/settings_reload", test_settings_reload);
+	g_test_add_func("/touchpanel/input/event_ring", test_event_ring);
+	ADD_MODULETEST("/touchpanel/input/queue_policy", test_queue_policy);
+	ADD_MODULETEST("/touchpanel/input/raw_mode", test_raw_mode);
+
+	ret = g_test_run();
+	g_free(settings_path);
+
+	return ret;
+}
@@ -31,6 +31,7 @@
 #include <glib.h>
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <nyx/nyx_module.h>
@@ -44,8 +45,16 @@
 #include <stdbool.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
+#include "touchpanel.h"
 #include "touchpanel_gestures.h"
+#include "touchpanel_common.h"
+#include "touchpanel_ring.h"
+#include "touchpanel_settings.h"
+#include "touchpanel_trace.h"
 #include "msgid.h"
 
 /* Later versions of nyx_utils.h no longer define this macro */
@@ -61,7 +70,8 @@ typedef struct
 {
 	nyx_device_t _parent;
 	nyx_event_touchpanel_t *current_event_ptr;
-	int32_t mode;
+	gint mode;      /**< touchpanel_mode_t, read by the reader thread, so
+                         access it atomically */
 } touchpanel_device_t;
 
 NYX_DECLARE_MODULE(NYX_DEVICE_TOUCHPANEL, "Touchpanel");
@@ -79,6 +89,65 @@ typedef struct
 event_list_t touchpanel_event_list;
 int touchpanel_event_fd = -1;
 
+/*
+ * Raw input read off the device on the caller's thread that hasn't been
+ * handled yet. The device is read in batches, one read() for up to
+ * MAX_HIDD_EVENTS events.
+ */
+static struct
+{
+	input_event_t events[MAX_HIDD_EVENTS];
+	int count;
+	int next;
+	bool full;      /**< the last read filled the batch, the device may have more */
+} touchpanel_raw;
+
+/*
+ * The fd handed out by touchpanel_get_event_source(). It is an epoll fd that
+ * is readable when the device has data, when synthesized events are still
+ * waiting in touchpanel_event_list or the gesture engine, or when a gesture
+ * timer expires, so the caller comes back for all of them. If it can't be
+ * set up the device fd is handed out instead.
+ */
+static int event_source_fd = -1;
+static int queue_signal_fd = -1;
+static int gesture_timer_fd = -1;
+static bool queue_signalled = false;
+static bool gesture_timer_armed = false;
+static time_stamp_t gesture_timer_deadline;
+
+/*
+ * Optional reader thread, see General/ReaderThread. It reads the device and
+ * runs the gesture engine, and hands the synthesized events to the caller's
+ * thread through reader_ring, which holds General/QueueSize events.
+ */
+#define READER_BATCH_SIZE   64      /* raw events per read */
+#define READER_BACKLOG_FRAMES   32
+
+static event_ring_t reader_ring;
+static pthread_t reader_thread;
+static bool reader_running = false;
+static int reader_stop_fd = -1;
+static int reader_space_fd = -1;
+static gint reader_waiting = 0;     /**< the thread waits for room in the ring */
+
+/*
+ * Frames the ring had no room for yet, oldest first, see General/QueuePolicy.
+ * Only touched by the reader thread.
+ */
+static input_event_t reader_backlog[2 * MAX_HIDD_EVENTS];
+static struct
+{
+	guint count;        /**< events */
+	bool moveOnly;      /**< only moves fingers, may be coalesced or dropped */
+} reader_backlog_frames[READER_BACKLOG_FRAMES];
+static guint reader_backlog_events = 0;
+static guint reader_backlog_len = 0;
+static bool reader_frame_open = false;  /**< the last chunk did not end the frame */
+
+static int start_reader_thread(touchpanel_device_t *touch_device);
+static void stop_reader_thread(void);
+
 static void touch_item_reset(nyx_touchpanel_event_item_t *t)
 {
 	t->finger = 0;
@@ -161,7 +230,7 @@ static nyx_touchpanel_event_item_t *touch_event_get_current_item(
 	return item_ptr;
 }
 
-static inline int64_t get_ts_tval(struct timeval *tv)
+static inline int64_t get_ts_tval(const struct timeval *tv)
 {
 	return tv->tv_sec * 1000000000LL + tv->tv_usec * 1000;
 }
@@ -226,6 +295,7 @@ typedef struct VMMdev_req_mouse_pointer
 	/** Pointer data. */
 	char pointerData[4];
 } VMMdev_req_mouse_pointer;
+#pragma pack()
 
 /* The purpose of this function is to enable mouse pointer on the screen
    for virtualbox qemux86 images, by firing appropriate ioctls to vbox driver */
@@ -310,17 +380,76 @@ error:
 }
 
 
+#ifndef TOUCHPANEL_SETTINGS_FILE
+#define TOUCHPANEL_SETTINGS_FILE "/etc/nyx-modules/touchpanel.conf"
+#endif
+
 /*
- * FIXME: The following two definitions are a temporary hack to work around
- * the fact that the XML file parsing reads in all the cypress-library
- * settings that we don't need or want (for dependency reasons)
+ * Built-in defaults, overridden by TOUCHPANEL_SETTINGS_FILE when the module
+ * is opened and whenever that file changes afterwards.
  */
 static general_settings_t sGeneralSettings =
 {
 	.coordBufSize = 6,
-	.fingerDownThreshold = 0
+	.fingerDownThreshold = 0,
+	.queueSize = 256,
+	.queuePolicy = QUEUE_POLICY_COALESCE,
+	.tapRadius = 10,
+	.tapTimeout = 300,
+	.doubleTapRadius = 30,
+	.doubleTapTimeout = 300,
+	.longPressTimeout = 500,
+	.flickMinVelocity = 500,
+	.palmWeightThreshold = 150,
+	.filterMinCutoff = 1.0,
+	.filterBeta = 0.007,
+	.filterDerivativeCutoff = 1.0,
+	.edgeSwipeZone = 0,
+	.edgeSwipeDistance = 5,
+	.edgeSwipeTimeout = 500
 };
 
+static int settings_watch_fd = -1;
+
+/*
+ * Only called between frames, so the gesture engine never sees a mix of old
+ * and new settings.
+ */
+static void
+apply_general_settings(const general_settings_t *pSettings)
+{
+	int coordBufSize = sGeneralSettings.coordBufSize;
+
+	sGeneralSettings = *pSettings;
+	g_atomic_int_set(&sGeneralSettings.fingerDownThreshold,
+	                 pSettings->fingerDownThreshold);
+
+	if (coordBufSize != pSettings->coordBufSize &&
+	        gesture_state_machine_set_coord_buf_size(pSettings->coordBufSize) < 0)
+	{
+		/* buffers that could not be resized kept their old size */
+		sGeneralSettings.coordBufSize = coordBufSize;
+	}
+}
+
+static void
+reload_general_settings(void)
+{
+	general_settings_t settings = sGeneralSettings;
+
+	if (!general_settings_changed(settings_watch_fd, TOUCHPANEL_SETTINGS_FILE))
+	{
+		return;
+	}
+
+	if (load_general_settings(TOUCHPANEL_SETTINGS_FILE, &settings) == 0)
+	{
+		nyx_info(MSGID_NYX_QMUX_TP_SETTINGS_RELOAD, 0, "Reloaded %s",
+		         TOUCHPANEL_SETTINGS_FILE);
+		apply_general_settings(&settings);
+	}
+}
+
 #define FRAMEBUF_DEVICE_NAME    "/dev/fb"
 
 static int
@@ -354,13 +483,204 @@ exit:
 }
 
 
+void
+get_time_stamp(time_stamp_t *pTime)
+{
+	struct timeval tv;
+	(void)gettimeofday(&tv, NULL);
+
+	pTime->time.tv_sec = tv.tv_sec;
+	pTime->time.tv_nsec = tv.tv_usec * 1000;
+}
+
+
+static void
+deinit_event_source(void)
+{
+	int *fds[] = { &event_source_fd, &queue_signal_fd, &gesture_timer_fd };
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(fds); i++)
+	{
+		if (*fds[i] >= 0)
+		{
+			close(*fds[i]);
+			*fds[i] = -1;
+		}
+	}
+
+	queue_signalled = false;
+	gesture_timer_armed = false;
+}
+
+static int
+init_event_source(void)
+{
+	int fds[3];
+	size_t i;
+
+	event_source_fd = epoll_create1(EPOLL_CLOEXEC);
+	queue_signal_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	gesture_timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (event_source_fd < 0 || queue_signal_fd < 0 || gesture_timer_fd < 0)
+	{
+		goto error;
+	}
+
+	fds[0] = touchpanel_event_fd;
+	fds[1] = queue_signal_fd;
+	fds[2] = gesture_timer_fd;
+
+	for (i = 0; i < G_N_ELEMENTS(fds); i++)
+	{
+		struct epoll_event event = { .events = EPOLLIN, .data.fd = fds[i] };
+
+		if (epoll_ctl(event_source_fd, EPOLL_CTL_ADD, fds[i], &event) < 0)
+		{
+			goto error;
+		}
+	}
+
+	return 0;
+
+error:
+	nyx_error(MSGID_NYX_QMUX_TP_EVENT_SOURCE_ERR, 0,
+	          "Failed to set up the event source: %d", errno);
+	deinit_event_source();
+	return -1;
+}
+
+/*
+ * Makes the event source readable while synthesized events are waiting, and
+ * arms the gesture timer for the next gesture timeout. Called after every
+ * touchpanel_get_event().
+ */
+static void
+update_event_source(void)
+{
+	time_stamp_t now, deadline;
+	uint64_t count = 1;
+	bool queued;
+	int timeout;
+
+	if (event_source_fd < 0)
+	{
+		return;
+	}
+
+	if (reader_running)
+	{
+		uint64_t count;
+
+		/*
+		 * The thread adds to the eventfd for every frame it queues. Clear it
+		 * once the ring is empty, and check again in case a frame came in
+		 * between.
+		 */
+		if (NULL == event_ring_peek(&reader_ring))
+		{
+			(void)read(queue_signal_fd, &count, sizeof(count));
+
+			if (NULL != event_ring_peek(&reader_ring))
+			{
+				count = 1;
+				(void)write(queue_signal_fd, &count, sizeof(count));
+			}
+		}
+
+		if (g_atomic_int_get(&reader_waiting))
+		{
+			count = 1;
+			(void)write(reader_space_fd, &count, sizeof(count));
+		}
+
+		return;
+	}
+
+	queued = touchpanel_event_list.input_read <
+	         touchpanel_event_list.input_filled || gesture_state_machine_pending() ||
+	         touchpanel_raw.next < touchpanel_raw.count;
+
+	if (queued != queue_signalled)
+	{
+		/* the eventfd is readable as long as its count isn't 0 */
+		if (queued)
+		{
+			(void)write(queue_signal_fd, &count, sizeof(count));
+		}
+		else
+		{
+			(void)read(queue_signal_fd, &count, sizeof(count));
+		}
+
+		queue_signalled = queued;
+	}
+
+	get_time_stamp(&now);
+	timeout = gesture_state_machine_get_timeout(&now);
+
+	if (timeout < 0)
+	{
+		if (gesture_timer_armed)
+		{
+			struct itimerspec disarm = { { 0, 0 }, { 0, 0 } };
+
+			timerfd_settime(gesture_timer_fd, 0, &disarm, NULL);
+			gesture_timer_armed = false;
+		}
+
+		return;
+	}
+
+	deadline = now;
+	deadline.time.tv_sec += timeout / 1000;
+	deadline.time.tv_nsec += (timeout % 1000) * 1000000L;
+
+	if (deadline.time.tv_nsec >= 1000000000L)
+	{
+		deadline.time.tv_sec++;
+		deadline.time.tv_nsec -= 1000000000L;
+	}
+
+	/*
+	 * The next deadline only moves forward when the finger it belongs to
+	 * goes up or starts moving, so a timer that is due earlier than needed
+	 * is left alone. If it fires early the wakeup just arms it again.
+	 */
+	if (!gesture_timer_armed ||
+	        time_stamp_diff_ms(&gesture_timer_deadline, &deadline) > 0)
+	{
+		struct itimerspec arm = { { 0, 0 }, deadline.time };
+
+		timerfd_settime(gesture_timer_fd, TFD_TIMER_ABSTIME, &arm, NULL);
+		gesture_timer_armed = true;
+		gesture_timer_deadline = deadline;
+	}
+}
+
 static float scaleX, scaleY;
 
+/*
+ * Panels that report ABS_MT_TOUCH_MAJOR give the length of the contact,
+ * which is its weight for the gesture engine, in px like the coordinates.
+ * That is what Rejection/PalmWeight is compared with. Other panels only
+ * tell whether they are touched, with a weight of 1.
+ */
+static bool touchMajorReported = false;
+static int cachedMajor = 0;
+
+#define test_bit(bits, bit) \
+  (((bits)[(bit) / (8 * sizeof((bits)[0]))] >> \
+    ((bit) % (8 * sizeof((bits)[0])))) & 1)
+
 static int
-init_touchpanel(void)
+init_touchpanel(touchpanel_device_t *touch_device)
 {
+	unsigned long absBits[ABS_MAX / (8 * sizeof(unsigned long)) + 1] = { 0 };
 	struct input_absinfo abs;
 	int  maxX, maxY, sXres, sYres, ret = -1;
+	bool gesturesInitialized = false;
 
 	touchpanel_event_fd = open("/dev/input/touchscreen0", O_RDWR);
 
@@ -390,9 +710,22 @@ init_touchpanel(void)
 
 	maxY = abs.maximum;
 
+	touchMajorReported = ioctl(touchpanel_event_fd,
+	                           EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) >= 0 &&
+	                     test_bit(absBits, ABS_MT_TOUCH_MAJOR);
+	cachedMajor = 0;
+
 	// The following function is valid only for virtualbox qemux86 image
 	init_vbox_touchpanel();
+
+	if (access(TOUCHPANEL_SETTINGS_FILE, F_OK) == 0)
+	{
+		load_general_settings(TOUCHPANEL_SETTINGS_FILE, &sGeneralSettings);
+	}
+
+	settings_watch_fd = watch_general_settings(TOUCHPANEL_SETTINGS_FILE);
 	init_gesture_state_machine(&sGeneralSettings, 1);
+	gesturesInitialized = true;
 
 	/* Get the display resolution */
 	if (get_display_res(&sXres, &sYres) < 0)
@@ -401,15 +734,40 @@ init_touchpanel(void)
 		goto error;
 	}
 
+	gesture_state_machine_set_screen_size(sXres, sYres);
+
 	scaleX = (float)sXres / (float)maxX;
 	scaleY = (float)sYres / (float)maxY;
 
+	if (init_event_source() < 0)
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_EVENT_SOURCE_ERR, 0,
+		          "Falling back to the device as event source");
+	}
+	else if (sGeneralSettings.readerThread && start_reader_thread(touch_device) < 0)
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_READER_THREAD_ERR, 0,
+		          "Reading input on the caller's thread instead");
+	}
+
 	return 0;
 error:
 
+	if (gesturesInitialized)
+	{
+		deinit_gesture_state_machine();
+	}
+
 	if (touchpanel_event_fd >= 0)
 	{
 		close(touchpanel_event_fd);
+		touchpanel_event_fd = -1;
+	}
+
+	if (settings_watch_fd >= 0)
+	{
+		close(settings_watch_fd);
+		settings_watch_fd = -1;
 	}
 
 	return ret;
@@ -434,6 +792,10 @@ nyx_error_t nyx_module_open(nyx_instance_t i, nyx_device_t **d)
 
 	nyx_module_register_method(i, (nyx_device_t *) touchpanel_device,
 	                           NYX_GET_EVENT_MODULE_METHOD, "touchpanel_get_event");
+#ifdef HAVE_NYX_GET_EVENTS_MODULE_METHOD
+	nyx_module_register_method(i, (nyx_device_t *) touchpanel_device,
+	                           NYX_GET_EVENTS_MODULE_METHOD, "touchpanel_get_events");
+#endif
 	nyx_module_register_method(i, (nyx_device_t *) touchpanel_device,
 	                           NYX_RELEASE_EVENT_MODULE_METHOD, "touchpanel_release_event");
 	nyx_module_register_method(i, (nyx_device_t *) touchpanel_device,
@@ -457,7 +819,7 @@ nyx_error_t nyx_module_open(nyx_instance_t i, nyx_device_t **d)
 
 	*d = (nyx_device_t *) touchpanel_device;
 
-	if (init_touchpanel() < 0)
+	if (init_touchpanel(touchpanel_device) < 0)
 	{
 		goto fail_unlock_settings;
 	}
@@ -481,15 +843,28 @@ nyx_error_t nyx_module_close(nyx_device_t *d)
 
 	nyx_debug("Freeing touchpanel %p", d);
 
+	stop_reader_thread();
+	tp_trace_dump_counters();
 	deinit_gesture_state_machine();
 	free(d);
 
+	deinit_event_source();
+
 	if (touchpanel_event_fd >= 0)
 	{
 		close(touchpanel_event_fd);
 		touchpanel_event_fd = -1;
 	}
 
+	touchpanel_raw.count = 0;
+	touchpanel_raw.next = 0;
+	touchpanel_raw.full = false;
+
+	if (settings_watch_fd >= 0)
+	{
+		close(settings_watch_fd);
+		settings_watch_fd = -1;
+	}
 
 	return NYX_ERROR_NONE;
 }
@@ -507,7 +882,7 @@ nyx_error_t touchpanel_get_event_source(nyx_device_t *d, int *f)
 		return NYX_ERROR_INVALID_VALUE;
 	}
 
-	*f = touchpanel_event_fd;
+	*f = event_source_fd >= 0 ? event_source_fd : touchpanel_event_fd;
 
 	return NYX_ERROR_NONE;
 }
@@ -518,30 +893,42 @@ nyx_error_t touchpanel_set_operating_mode(nyx_device_t *d,
 	return NYX_ERROR_NOT_IMPLEMENTED;
 }
 
-void
-get_time_stamp(time_stamp_t *pTime)
+int cachedX, cachedY;
+
+/*
+ * Where the next synthesized events go: after those still waiting in the
+ * event list, which is at most a move read_input_event() holds back. Room
+ * is set to the number of events that fit.
+ */
+static input_event_t *
+event_list_tail(int *pRoom)
 {
-	struct timeval tv;
-	(void)gettimeofday(&tv, NULL);
+	size_t filled;
 
-	pTime->time.tv_sec = tv.tv_sec;
-	pTime->time.tv_nsec = tv.tv_usec * 1000;
-}
+	if (touchpanel_event_list.input_read == touchpanel_event_list.input_filled)
+	{
+		touchpanel_event_list.input_filled = 0;
+		touchpanel_event_list.input_read = 0;
+	}
 
+	filled = touchpanel_event_list.input_filled / sizeof(input_event_t);
+	*pRoom = MAX_HIDD_EVENTS - filled;
 
-int cachedX, cachedY;
+	return &touchpanel_event_list.input[filled];
+}
 
 static void
 generate_mouse_gesture(int touchButtonState)
 {
 	int32_t xOrd[2], yOrd[2], wOrd[2], fingers;
 	time_stamp_t eventTime;
-	int num_events = 0;
+	int num_events = 0, room;
+	input_event_t *pEvents = event_list_tail(&room);
 
 	get_time_stamp(&eventTime);
 	xOrd[0] = cachedX;
 	yOrd[0] = cachedY;
-	wOrd[0] = touchButtonState ? 1 : 0;
+	wOrd[0] = !touchButtonState ? 0 : touchMajorReported ? MAX(cachedMajor, 1) : 1;
 	fingers = touchButtonState ? 1 : 0;
 
 	xOrd[1] = 0;
@@ -549,9 +936,91 @@ generate_mouse_gesture(int touchButtonState)
 	wOrd[1] = 0;
 
 	gesture_state_machine(xOrd, yOrd, wOrd, fingers, &eventTime,
-	                      touchpanel_event_list.input, &num_events);
-	touchpanel_event_list.input_filled = num_events * sizeof(input_event_t);
-	touchpanel_event_list.input_read = 0;
+	                      pEvents, room, &num_events);
+	touchpanel_event_list.input_filled += num_events * sizeof(input_event_t);
+}
+
+
+static void
+set_raw_event(input_event_t *pEvent, const struct timeval *pTime,
+              uint16_t type, uint16_t code, int32_t value)
+{
+	pEvent->time = *pTime;
+	pEvent->type = type;
+	pEvent->code = code;
+	pEvent->value = value;
+}
+
+/*
+ * Raw mode: reports the contact as the device does, with its transformed
+ * coordinates and the kernel timestamp, in the same events the gesture
+ * engine produces. Moves while nothing touches are left out.
+ */
+static void
+generate_raw_contact(int touchButtonState, const struct timeval *pTime)
+{
+	static bool down = false;
+	static int32_t contactId = 0;
+	int num_events = 0, room;
+	input_event_t *pEvents = event_list_tail(&room);
+
+	if (!touchButtonState && !down)
+	{
+		return;
+	}
+
+	if (touchButtonState && !down)
+	{
+		contactId++;
+	}
+
+	set_raw_event(&pEvents[num_events++], pTime, EV_FINGERID, 0, contactId);
+	set_raw_event(&pEvents[num_events++], pTime, EV_ABS, ABS_X, cachedX);
+	set_raw_event(&pEvents[num_events++], pTime, EV_ABS, ABS_Y, cachedY);
+
+	if (touchButtonState != down)
+	{
+		set_raw_event(&pEvents[num_events++], pTime, EV_KEY, BTN_TOUCH,
+		              touchButtonState ? 1 : 0);
+	}
+
+	set_raw_event(&pEvents[num_events++], pTime, EV_SYN, 0, 0);
+
+	down = touchButtonState;
+	touchpanel_event_list.input_filled += num_events * sizeof(input_event_t);
+}
+
+/*
+ * No new input, but a finger may be held still long enough for one of the
+ * gesture timers to expire.
+ */
+static void
+generate_gesture_timeout(void)
+{
+	time_stamp_t eventTime;
+	int num_events = 0, room;
+	input_event_t *pEvents;
+
+	if (gesture_timer_fd >= 0)
+	{
+		uint64_t expirations;
+
+		if (read(gesture_timer_fd, &expirations, sizeof(expirations)) > 0)
+		{
+			gesture_timer_armed = false;
+		}
+	}
+
+	get_time_stamp(&eventTime);
+
+	if (gesture_state_machine_get_timeout(&eventTime) != 0)
+	{
+		return;
+	}
+
+	pEvents = event_list_tail(&room);
+	gesture_state_machine_timeout(&eventTime, pEvents, room, &num_events);
+	touchpanel_event_list.input_filled += num_events * sizeof(input_event_t);
 }
 
 
@@ -562,9 +1031,68 @@ generate_mouse_gesture(int touchButtonState)
 #define SYN_START       8
 
 
-static void handle_new_event(input_event_t *event)
+/*
+ * Picks up the position and button state again after the kernel dropped
+ * input. Whatever can't be queried keeps its cached value.
+ */
+static void resync_touch_state(int *pTouchButtonState)
+{
+	unsigned long keys[KEY_MAX / (8 * sizeof(unsigned long)) + 1] = { 0 };
+	struct input_absinfo abs;
+
+	if (ioctl(touchpanel_event_fd, EVIOCGABS(ABS_X), &abs) == 0)
+	{
+		cachedX = (int)(abs.value * scaleX);
+	}
+
+	if (ioctl(touchpanel_event_fd, EVIOCGABS(ABS_Y), &abs) == 0)
+	{
+		cachedY = (int)(abs.value * scaleY);
+	}
+
+	if (touchMajorReported &&
+	        ioctl(touchpanel_event_fd, EVIOCGABS(ABS_MT_TOUCH_MAJOR), &abs) == 0)
+	{
+		cachedMajor = (int)(abs.value * scaleX);
+	}
+
+	if (ioctl(touchpanel_event_fd, EVIOCGKEY(sizeof(keys)), keys) >= 0)
+	{
+		*pTouchButtonState = test_bit(keys, BTN_TOUCH) ||
+		                     test_bit(keys, BTN_LEFT);
+	}
+}
+
+static void handle_new_event(touchpanel_device_t *touch_device,
+                             input_event_t *event)
 {
 	static int touchButtonState = 0;
+	static bool resyncing = false;
+	static bool contactDown = false;
+	static int activeMode = TOUCHPANEL_MODE_GESTURES;
+
+	/*
+	 * The kernel ran out of room for our input. The events up to the next
+	 * report are incomplete, skip them and query the state instead.
+	 */
+	if ((event->type == EV_SYN) && (event->code == SYN_DROPPED))
+	{
+		TP_TRACE_INFO(TP_TRACE_INPUT_DROPPED, MSGID_NYX_QMUX_TP_INPUT_DROPPED,
+		              "Kernel dropped touchpanel input");
+		resyncing = true;
+		return;
+	}
+
+	if (resyncing)
+	{
+		if ((event->type != EV_SYN) || (event->code != SYN_REPORT))
+		{
+			return;
+		}
+
+		resyncing = false;
+		resync_touch_state(&touchButtonState);
+	}
 
 	// Truncate scaled X & Y coordinate values
 	if ((event->type == EV_ABS) && (event->code == ABS_X))
@@ -577,6 +1105,11 @@ static void handle_new_event(input_event_t *event)
 		cachedY = (int)(event->value * scaleY);
 	}
 
+	else if ((event->type == EV_ABS) && (event->code == ABS_MT_TOUCH_MAJOR))
+	{
+		cachedMajor = (int)(event->value * scaleX);
+	}
+
 	// qemu touchpanel sends BTN_TOUCH, virtualbox touchpanel sends BTN_LEFT
 	else if ((event->type == EV_KEY) && ((event->code == BTN_TOUCH) ||
 	                                     (event->code == BTN_LEFT)))
@@ -584,7 +1117,7 @@ static void handle_new_event(input_event_t *event)
 		// save touchButtonState (up or down)
 		touchButtonState = event->value;
 
-		if (touchButtonState == 0)
+		if (touchButtonState == 0 && activeMode == TOUCHPANEL_MODE_GESTURES)
 		{
 			/* generate another event with the coordinates and time of the
 			* release point so that we can calculate how long the mouse
@@ -596,7 +1129,22 @@ static void handle_new_event(input_event_t *event)
 	}
 	else if (event->type == EV_SYN)
 	{
-		generate_mouse_gesture(touchButtonState);
+		/* only switch modes between touches */
+		if (!contactDown)
+		{
+			activeMode = g_atomic_int_get(&touch_device->mode);
+		}
+
+		if (activeMode == TOUCHPANEL_MODE_RAW)
+		{
+			generate_raw_contact(touchButtonState, &event->time);
+		}
+		else
+		{
+			generate_mouse_gesture(touchButtonState);
+		}
+
+		contactDown = touchButtonState;
 	}
 
 	if ((event->type == EV_REL && event->code == REL_WHEEL) ||
@@ -605,7 +1153,10 @@ static void handle_new_event(input_event_t *event)
 	                                   event->code == BTN_EXTRA || event->code == BTN_FORWARD ||
 	                                   event->code == BTN_BACK || event->code == BTN_TASK)))
 	{
-		memcpy(&touchpanel_event_list.input[0], event, sizeof(input_event_t));
+		int room;
+		input_event_t *pEvents = event_list_tail(&room);
+
+		memcpy(&pEvents[0], event, sizeof(input_event_t));
 		// Forward an EV_SYN after the key event, to make sure it is processed immediately.
 		input_event_t syn_event;
 		syn_event.type = EV_SYN;
@@ -614,10 +1165,9 @@ static void handle_new_event(input_event_t *event)
 		syn_event.time.tv_sec = 0;
 		syn_event.time.tv_usec = 0;
 
-		memcpy(&touchpanel_event_list.input[1], &syn_event, sizeof(input_event_t));
+		memcpy(&pEvents[1], &syn_event, sizeof(input_event_t));
 
-		touchpanel_event_list.input_filled = 2 * sizeof(input_event_t);
-		touchpanel_event_list.input_read = 0;
+		touchpanel_event_list.input_filled += 2 * sizeof(input_event_t);
 	}
 
 	return;
@@ -625,173 +1175,799 @@ static void handle_new_event(input_event_t *event)
 
 static struct pollfd fds[1];
 
-static int
-read_input_event(void)
+/*
+ * Frames that only move fingers can be replaced by a newer position, or left
+ * out, without the consumer losing track of a finger. Anything that puts
+ * fingers down, lifts them or carries gestures has to be delivered.
+ */
+static bool
+frame_is_move_only(const input_event_t *pEvents, guint count)
 {
-	int numEvents = 0;
-	int rd = 0;
-	input_event_t pEvent;
+	guint i;
 
-	fds[0].fd = touchpanel_event_fd;
-	fds[0].events = POLLIN;
+	if (count == 0 || pEvents[count - 1].type != EV_SYN)
+	{
+		return false;
+	}
 
-	int ret_val = poll(fds, 1, 0);
+	for (i = 0; i < count; i++)
+	{
+		if (pEvents[i].type != EV_FINGERID && pEvents[i].type != EV_ABS &&
+		        pEvents[i].type != EV_SYN)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
 
-	if (ret_val <= 0)
+/*
+ * Handles raw input until it completes an event list, reading the next
+ * batch off the device once the last one is used up.
+ */
+static int
+read_input_event(touchpanel_device_t *touch_device)
+{
+	bool coalesce = sGeneralSettings.queuePolicy == QUEUE_POLICY_COALESCE;
+	int numEvents = 0;
+	ssize_t rd = 0;
+
+	/* deliver what didn't fit into the event list last time first */
+	if (gesture_state_machine_pending())
 	{
-		return 0;
+		gesture_state_machine_resume(touchpanel_event_list.input, MAX_HIDD_EVENTS,
+		                             &numEvents);
+		touchpanel_event_list.input_filled = numEvents * sizeof(input_event_t);
+		touchpanel_event_list.input_read = 0;
+		return numEvents;
 	}
 
-	if (fds[0].revents & POLLIN)
+	if (touchpanel_raw.next == touchpanel_raw.count)
 	{
-		rd = read(fds[0].fd, &pEvent, sizeof(input_event_t));
+		fds[0].fd = touchpanel_event_fd;
+		fds[0].events = POLLIN;
+
+		int ret_val = poll(fds, 1, 0);
+
+		touchpanel_raw.full = false;
+
+		if (ret_val == 0)
+		{
+			generate_gesture_timeout();
+			return 0;
+		}
+
+		if (ret_val < 0 || !(fds[0].revents & POLLIN))
+		{
+			return 0;
+		}
+
+		rd = read(fds[0].fd, touchpanel_raw.events, sizeof(touchpanel_raw.events));
 
-		if (rd < 0 && errno != EINTR)
+		if (rd < 0)
 		{
-			nyx_error(MSGID_NYX_QMUX_TP_EVT_READ_ERR, 0, "Failed to read events from keypad event file");
+			if (errno == EINTR)
+			{
+				return 0;
+			}
+
+			nyx_error(MSGID_NYX_QMUX_TP_EVT_READ_ERR, 0, "Failed to read events from touchpanel event file");
 			return -1;
 		}
 
-		handle_new_event(&pEvent);
+		touchpanel_raw.count = rd / sizeof(input_event_t);
+		touchpanel_raw.next = 0;
+		touchpanel_raw.full = touchpanel_raw.count == (int)MAX_HIDD_EVENTS;
 	}
 
-	return numEvents;
+	touchpanel_event_list.input_filled = 0;
+	touchpanel_event_list.input_read = 0;
+
+	/*
+	 * Input left in the batch once a frame is complete came in before the
+	 * consumer fetched that frame, it falls behind. With QueuePolicy=1 a
+	 * frame that only moves fingers is then held back, and replaced if the
+	 * next one only moves them as well, like the reader thread does once its
+	 * queue is full.
+	 */
+	while (touchpanel_raw.next < touchpanel_raw.count)
+	{
+		guint start = touchpanel_event_list.input_filled / sizeof(input_event_t);
+		guint filled;
+
+		handle_new_event(touch_device, &touchpanel_raw.events[touchpanel_raw.next++]);
+		filled = touchpanel_event_list.input_filled / sizeof(input_event_t);
+
+		if (filled == start)
+		{
+			continue;
+		}
+
+		if (!coalesce || gesture_state_machine_pending() ||
+		        !frame_is_move_only(&touchpanel_event_list.input[start], filled - start))
+		{
+			break;
+		}
+
+		if (start > 0)
+		{
+			TP_TRACE_DEBUG(TP_TRACE_FRAMES_COALESCED,
+			               "Replaced a held back move with a newer one");
+			memmove(&touchpanel_event_list.input[0], &touchpanel_event_list.input[start],
+			        (filled - start) * sizeof(input_event_t));
+			touchpanel_event_list.input_filled = (filled - start) *
+			                                     sizeof(input_event_t);
+		}
+	}
+
+	return touchpanel_event_list.input_filled / sizeof(input_event_t);
 }
 
-nyx_error_t touchpanel_get_event(nyx_device_t *d, nyx_event_t **e)
+static void
+reader_backlog_remove(guint index)
 {
-	int event_count = 0;
-	int event_iter = 0;
-	static int read_input = 0;
+	guint start = 0;
+	guint count = reader_backlog_frames[index].count;
+	guint i;
 
-	nyx_event_t *p_generated = NULL;
-	touchpanel_device_t *touch_device = (touchpanel_device_t *) d;
+	for (i = 0; i < index; i++)
+	{
+		start += reader_backlog_frames[i].count;
+	}
+
+	memmove(&reader_backlog[start], &reader_backlog[start + count],
+	        (reader_backlog_events - start - count) * sizeof(input_event_t));
+	memmove(&reader_backlog_frames[index], &reader_backlog_frames[index + 1],
+	        (reader_backlog_len - index - 1) * sizeof(reader_backlog_frames[0]));
+	reader_backlog_events -= count;
+	reader_backlog_len--;
+}
+
+/*
+ * Moves as many frames of the backlog into the ring as fit, in order.
+ * Returns true if the backlog is empty afterwards.
+ */
+static bool
+reader_backlog_flush(void)
+{
+	uint64_t one = 1;
+	bool pushed = false;
+
+	if (reader_backlog_len == 0)
+	{
+		return true;
+	}
 
 	/*
-	 * Event bookkeeping...
+	 * Tell the consumer before trying, so that either we see the room it
+	 * made or it sees that we wait for it.
 	 */
-	if (!read_input)
+	g_atomic_int_set(&reader_waiting, 1);
+
+	while (reader_backlog_len &&
+	        event_ring_push(&reader_ring, reader_backlog,
+	                        reader_backlog_frames[0].count))
 	{
-		read_input_event();
-		touch_device->current_event_ptr = NULL;
-		read_input = 1;
+		reader_backlog_remove(0);
+		pushed = true;
 	}
 
-	/*
-	* Event bookkeeping...
-	*/
-	event_count = touchpanel_event_list.input_filled / sizeof(input_event_t);
-	event_iter = touchpanel_event_list.input_read / sizeof(input_event_t);
+	if (pushed)
+	{
+		(void)write(queue_signal_fd, &one, sizeof(one));
+	}
 
-	if (event_iter == event_count)
+	if (reader_backlog_len == 0)
 	{
-		read_input = 0;
+		g_atomic_int_set(&reader_waiting, 0);
+		return true;
 	}
 
-	if (touch_device->current_event_ptr == NULL)
+	return false;
+}
+
+/*
+ * Waits until the consumer made room in the ring for the oldest frame of the
+ * backlog. Returns false if the thread is asked to stop meanwhile.
+ */
+static bool
+reader_wait_for_space(void)
+{
+	struct pollfd fds[2] =
 	{
-		/*
-		* let's allocate new event and hold it here.
-		*/
-		touch_device->current_event_ptr = touch_event_create();
+		{ .fd = reader_space_fd, .events = POLLIN },
+		{ .fd = reader_stop_fd, .events = POLLIN },
+	};
+	guint len = reader_backlog_len;
+	uint64_t signalled;
+
+	while (reader_backlog_len == len && !reader_backlog_flush())
+	{
+		if (poll(fds, 2, -1) < 0 && errno != EINTR)
+		{
+			return false;
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			return false;
+		}
+
+		(void)read(reader_space_fd, &signalled, sizeof(signalled));
 	}
 
-	touch_device->current_event_ptr->_parent.type = NYX_EVENT_TOUCHPANEL;
+	return true;
+}
+
+/*
+ * Queues a chunk of synthesized events for the consumer. Whatever does not
+ * fit into the ring goes to the backlog, which General/QueuePolicy keeps
+ * bounded. Returns false if the thread is asked to stop meanwhile.
+ */
+static bool
+reader_queue(const input_event_t *pEvents, guint count)
+{
+	uint64_t one = 1;
+	bool moveOnly = !reader_frame_open && frame_is_move_only(pEvents, count);
+	bool coalesce = sGeneralSettings.queuePolicy == QUEUE_POLICY_COALESCE;
+
+	reader_frame_open = pEvents[count - 1].type != EV_SYN;
 
-	for (; event_iter < event_count; event_iter++)
+	if (reader_backlog_flush() && event_ring_push(&reader_ring, pEvents, count))
 	{
-		input_event_t *input_event_ptr;
-		nyx_touchpanel_event_item_t *item_ptr;
-		input_event_ptr = &touchpanel_event_list.input[event_iter];
+		(void)write(queue_signal_fd, &one, sizeof(one));
+		return true;
+	}
 
-		touchpanel_event_list.input_read += sizeof(input_event_t);
+	if (coalesce && moveOnly && reader_backlog_len &&
+	        reader_backlog_frames[reader_backlog_len - 1].moveOnly)
+	{
+		TP_TRACE_DEBUG(TP_TRACE_FRAMES_COALESCED,
+		               "Replaced a queued move with a newer one");
+		reader_backlog_remove(reader_backlog_len - 1);
+	}
+
+	while (reader_backlog_len == READER_BACKLOG_FRAMES ||
+	        reader_backlog_events + count > G_N_ELEMENTS(reader_backlog))
+	{
+		guint i;
+
+		for (i = 0; coalesce && i < reader_backlog_len; i++)
+		{
+			if (reader_backlog_frames[i].moveOnly)
+			{
+				break;
+			}
+		}
+
+		if (coalesce && i < reader_backlog_len)
+		{
+			TP_TRACE_INFO(TP_TRACE_FRAMES_DROPPED, MSGID_NYX_QMUX_TP_EVENTS_DROPPED,
+			              "Consumer too slow, dropped a queued move");
+			reader_backlog_remove(i);
+		}
+		else if (!reader_wait_for_space())
+		{
+			return false;
+		}
+	}
+
+	memcpy(&reader_backlog[reader_backlog_events], pEvents,
+	       count * sizeof(input_event_t));
+	reader_backlog_frames[reader_backlog_len].count = count;
+	reader_backlog_frames[reader_backlog_len].moveOnly = moveOnly;
+	reader_backlog_events += count;
+	reader_backlog_len++;
+
+	reader_backlog_flush();
+
+	return true;
+}
+
+/*
+ * Queues the events synthesized into the event list, and whatever the
+ * gesture engine still holds back. Returns false if the thread is asked to
+ * stop meanwhile.
+ */
+static bool
+reader_flush(void)
+{
+	for (;;)
+	{
+		guint first = touchpanel_event_list.input_read / sizeof(input_event_t);
+		guint count = touchpanel_event_list.input_filled / sizeof(input_event_t) -
+		              first;
+		int numEvents = 0;
+
+		if (count)
+		{
+			if (!reader_queue(&touchpanel_event_list.input[first], count))
+			{
+				return false;
+			}
+
+			touchpanel_event_list.input_read = touchpanel_event_list.input_filled;
+		}
+
+		if (!gesture_state_machine_pending())
+		{
+			return true;
+		}
+
+		gesture_state_machine_resume(touchpanel_event_list.input, MAX_HIDD_EVENTS,
+		                             &numEvents);
+		touchpanel_event_list.input_filled = numEvents * sizeof(input_event_t);
+		touchpanel_event_list.input_read = 0;
+	}
+}
+
+static void *
+reader_thread_main(void *arg)
+{
+	touchpanel_device_t *touch_device = arg;
+	input_event_t raw[READER_BATCH_SIZE];
+
+	for (;;)
+	{
+		struct pollfd fds[4] =
+		{
+			{ .fd = touchpanel_event_fd, .events = POLLIN },
+			{ .fd = reader_stop_fd, .events = POLLIN },
+			{ .fd = settings_watch_fd, .events = POLLIN },
+			{ .fd = reader_space_fd, .events = POLLIN },
+		};
+		time_stamp_t now;
+		uint64_t signalled;
+		ssize_t rd;
+		int ret, i;
+
+		get_time_stamp(&now);
+		ret = poll(fds, 4, gesture_state_machine_get_timeout(&now));
+
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			break;
+		}
+
+		if (fds[2].revents & POLLIN)
+		{
+			reload_general_settings();
+		}
 
-		switch (input_event_ptr->type)
+		if (fds[3].revents & POLLIN)
 		{
-			case EV_FINGERID:
+			(void)read(reader_space_fd, &signalled, sizeof(signalled));
+			reader_backlog_flush();
+		}
+
+		if (ret == 0)
+		{
+			generate_gesture_timeout();
+
+			if (!reader_flush())
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		if (!(fds[0].revents & POLLIN))
+		{
+			if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+			{
+				nyx_error(MSGID_NYX_QMUX_TP_READER_THREAD_ERR, 0,
+				          "Touchpanel device went away");
+				break;
+			}
+
+			continue;
+		}
+
+		rd = read(touchpanel_event_fd, raw, sizeof(raw));
+
+		if (rd < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+			{
+				continue;
+			}
+
+			nyx_error(MSGID_NYX_QMUX_TP_EVT_READ_ERR, 0,
+			          "Failed to read events from touchpanel event file");
+			break;
+		}
+
+		for (i = 0; i < rd / (ssize_t)sizeof(input_event_t); i++)
+		{
+			handle_new_event(touch_device, &raw[i]);
+
+			if (!reader_flush())
+			{
+				return NULL;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Moves reading the device and running the gesture engine to a thread of
+ * its own. Needs the event source, which then no longer watches the device.
+ */
+static int
+start_reader_thread(touchpanel_device_t *touch_device)
+{
+	guint ringSize = 1;
+
+	while (ringSize < (guint)sGeneralSettings.queueSize)
+	{
+		ringSize <<= 1;
+	}
+
+	if (event_source_fd < 0 || event_ring_init(&reader_ring, ringSize) < 0)
+	{
+		return -1;
+	}
+
+	reader_backlog_events = 0;
+	reader_backlog_len = 0;
+	reader_frame_open = false;
+
+	reader_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	reader_space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (reader_stop_fd < 0 || reader_space_fd < 0)
+	{
+		goto error;
+	}
+
+	epoll_ctl(event_source_fd, EPOLL_CTL_DEL, touchpanel_event_fd, NULL);
+	reader_running = true;
+
+	if (pthread_create(&reader_thread, NULL, reader_thread_main,
+	                   touch_device) != 0)
+	{
+		struct epoll_event event = { .events = EPOLLIN, .data.fd = touchpanel_event_fd };
+
+		epoll_ctl(event_source_fd, EPOLL_CTL_ADD, touchpanel_event_fd, &event);
+		reader_running = false;
+		goto error;
+	}
+
+	nyx_debug("Reading touchpanel input on a separate thread");
+	return 0;
+
+error:
+	nyx_error(MSGID_NYX_QMUX_TP_READER_THREAD_ERR, 0,
+	          "Failed to start the reader thread: %d", errno);
+	stop_reader_thread();
+	return -1;
+}
+
+static void
+stop_reader_thread(void)
+{
+	uint64_t one = 1;
+
+	if (reader_running)
+	{
+		(void)write(reader_stop_fd, &one, sizeof(one));
+		pthread_join(reader_thread, NULL);
+		reader_running = false;
+	}
+
+	if (reader_stop_fd >= 0)
+	{
+		close(reader_stop_fd);
+		reader_stop_fd = -1;
+	}
+
+	if (reader_space_fd >= 0)
+	{
+		close(reader_space_fd);
+		reader_space_fd = -1;
+	}
+
+	event_ring_free(&reader_ring);
+}
+
+/*
+ * Adds one synthesized input event to the touch event being built. Returns
+ * the touch event once it is complete, otherwise NULL.
+ */
+static nyx_event_t *
+touch_event_process(touchpanel_device_t *touch_device,
+                    const input_event_t *input_event_ptr)
+{
+	nyx_event_t *p_generated = NULL;
+	nyx_touchpanel_event_item_t *item_ptr;
+
+	switch (input_event_ptr->type)
+	{
+		case EV_FINGERID:
+			item_ptr = touch_event_get_next_item(
+			               touch_device->current_event_ptr);
+
+			if (NULL == item_ptr)
+			{
+				p_generated = (nyx_event_t *) touch_device->current_event_ptr;
+				touch_device->current_event_ptr = touch_event_create();
 				item_ptr = touch_event_get_next_item(
 				               touch_device->current_event_ptr);
+			}
 
-				if (NULL == item_ptr)
+			if (NULL != item_ptr)
+			{
+				touch_item_reset(item_ptr);
+				item_ptr->finger = input_event_ptr->value * 1000
+				                   + input_event_ptr->code;
+				item_ptr->timestamp = get_ts_tval(&(input_event_ptr->time));
+			}
+
+			break;
+
+		case EV_ABS:
+			item_ptr = touch_event_get_current_item(
+			               touch_device->current_event_ptr);
+
+			if (NULL != item_ptr)
+			{
+				if (ABS_X == input_event_ptr->code)
 				{
-					p_generated = (nyx_event_t *) touch_device->current_event_ptr;
-					touch_device->current_event_ptr = touch_event_create();
-					item_ptr = touch_event_get_next_item(
-					               touch_device->current_event_ptr);
+					item_ptr->x = input_event_ptr->value;
 				}
-
-				if (NULL != item_ptr)
+				else if (ABS_Y == input_event_ptr->code)
 				{
-					touch_item_reset(item_ptr);
-					item_ptr->finger = input_event_ptr->value * 1000
-					                   + input_event_ptr->code;
-					item_ptr->timestamp = get_ts_tval(&(input_event_ptr->time));
+					item_ptr->y = input_event_ptr->value;
+				}
+				else
+				{
+					nyx_error(MSGID_NYX_QMUX_TP_ABS_ERR, 0, "Unexpected code 0x%x", input_event_ptr->code);
 				}
+			}
 
-				break;
+			break;
 
-			case EV_ABS:
-				item_ptr = touch_event_get_current_item(
-				               touch_device->current_event_ptr);
+		case EV_KEY:
+			item_ptr = touch_event_get_current_item(
+			               touch_device->current_event_ptr);
 
-				if (NULL != item_ptr)
+			if (NULL != item_ptr)
+			{
+				if (BTN_TOUCH == input_event_ptr->code)
 				{
-					if (ABS_X == input_event_ptr->code)
-					{
-						item_ptr->x = input_event_ptr->value;
-					}
-					else if (ABS_Y == input_event_ptr->code)
+					if (1 == input_event_ptr->value)
 					{
-						item_ptr->y = input_event_ptr->value;
+						item_ptr->state = NYX_TOUCHPANEL_STATE_DOWN;
 					}
 					else
 					{
-						nyx_error(MSGID_NYX_QMUX_TP_ABS_ERR, 0, "Unexpected code 0x%x", input_event_ptr->code);
+						item_ptr->state = NYX_TOUCHPANEL_STATE_UP;
 					}
 				}
+			}
 
-				break;
+			break;
 
-			case EV_KEY:
-				item_ptr = touch_event_get_current_item(
+		case EV_GESTURE:
+			if (GESTURE_CODE_ITEM == input_event_ptr->code)
+			{
+				item_ptr = touch_event_get_next_item(
 				               touch_device->current_event_ptr);
 
+				if (NULL == item_ptr)
+				{
+					p_generated = (nyx_event_t *) touch_device->current_event_ptr;
+					touch_device->current_event_ptr = touch_event_create();
+					item_ptr = touch_event_get_next_item(
+					               touch_device->current_event_ptr);
+				}
+
 				if (NULL != item_ptr)
 				{
-					if (BTN_TOUCH == input_event_ptr->code)
-					{
-						if (1 == input_event_ptr->value)
-						{
-							item_ptr->state = NYX_TOUCHPANEL_STATE_DOWN;
-						}
-						else
-						{
-							item_ptr->state = NYX_TOUCHPANEL_STATE_UP;
-						}
-					}
+					touch_item_reset(item_ptr);
+					item_ptr->finger = TOUCHPANEL_GESTURE_ITEM_FINGER;
+					item_ptr->gestureKey = input_event_ptr->value;
+					item_ptr->timestamp = get_ts_tval(&(input_event_ptr->time));
 				}
 
 				break;
+			}
 
-			case EV_SYN:
-				p_generated = (nyx_event_t *) touch_device->current_event_ptr;
-				touch_device->current_event_ptr = NULL;
+			item_ptr = touch_event_get_current_item(
+			               touch_device->current_event_ptr);
 
-				break;
+			if (NULL != item_ptr)
+			{
+				if (GESTURE_CODE_KEY == input_event_ptr->code)
+				{
+					item_ptr->gestureKey = input_event_ptr->value;
+				}
+				else if (GESTURE_CODE_VEL_X == input_event_ptr->code)
+				{
+					item_ptr->xVelocity = input_event_ptr->value;
+				}
+				else if (GESTURE_CODE_VEL_Y == input_event_ptr->code)
+				{
+					item_ptr->yVelocity = input_event_ptr->value;
+				}
+				else if (GESTURE_CODE_WEIGHT == input_event_ptr->code)
+				{
+					item_ptr->weight = (double) input_event_ptr->value /
+					                   GESTURE_WEIGHT_SCALE;
+				}
+			}
 
-			default:
-				nyx_warn(MSGID_NYX_QMUX_TP_INVALID_EVENT, 0, "Invalid event type (0x%x)", input_event_ptr->type);
-				break;
-		}
+			break;
 
-		// Generated event, bail out and let the caller know.
-		if (NULL != p_generated)
-		{
+		case EV_SYN:
+			p_generated = (nyx_event_t *) touch_device->current_event_ptr;
+			touch_device->current_event_ptr = NULL;
+
+			break;
+
+		default:
+			nyx_warn(MSGID_NYX_QMUX_TP_INVALID_EVENT, 0, "Invalid event type (0x%x)", input_event_ptr->type);
 			break;
+	}
+
+	return p_generated;
+}
+
+nyx_error_t touchpanel_get_event(nyx_device_t *d, nyx_event_t **e)
+{
+	int event_count = 0;
+	int event_iter = 0;
+
+	nyx_event_t *p_generated = NULL;
+	touchpanel_device_t *touch_device = (touchpanel_device_t *) d;
+
+	if (touch_device->current_event_ptr == NULL)
+	{
+		/*
+		* let's allocate new event and hold it here.
+		*/
+		touch_device->current_event_ptr = touch_event_create();
+	}
+
+	touch_device->current_event_ptr->_parent.type = NYX_EVENT_TOUCHPANEL;
+
+	/*
+	 * The reader thread owns the device, the gesture engine and the event
+	 * list, all that is left to do here is to take its events off the ring.
+	 */
+	if (reader_running)
+	{
+		const input_event_t *input_event_ptr;
+
+		while (NULL == p_generated &&
+		        NULL != (input_event_ptr = event_ring_peek(&reader_ring)))
+		{
+			p_generated = touch_event_process(touch_device, input_event_ptr);
+			event_ring_pop(&reader_ring);
 		}
+
+		*e = p_generated;
+		update_event_source();
+
+		return NYX_ERROR_NONE;
+	}
+
+	/*
+	 * Only read new input once the event list has been delivered. A frame
+	 * that was split across event lists is still being built in
+	 * current_event_ptr, so keep it.
+	 */
+	if (touchpanel_event_list.input_read == touchpanel_event_list.input_filled)
+	{
+		reload_general_settings();
+		read_input_event(touch_device);
+	}
+
+	/*
+	* Event bookkeeping...
+	*/
+	event_count = touchpanel_event_list.input_filled / sizeof(input_event_t);
+	event_iter = touchpanel_event_list.input_read / sizeof(input_event_t);
+
+	for (; NULL == p_generated && event_iter < event_count; event_iter++)
+	{
+		touchpanel_event_list.input_read += sizeof(input_event_t);
+		p_generated = touch_event_process(touch_device,
+		                                  &touchpanel_event_list.input[event_iter]);
 	}
 
 	*e = p_generated;
+	update_event_source();
+
+	return NYX_ERROR_NONE;
+}
+
+/* true if another touchpanel_get_event() could make progress right away */
+static bool
+touchpanel_input_pending(void)
+{
+	if (reader_running)
+	{
+		return NULL != event_ring_peek(&reader_ring);
+	}
+
+	/*
+	 * A batch that wasn't full drained the device, whatever came in since
+	 * wakes the event source.
+	 */
+	return touchpanel_event_list.input_read < touchpanel_event_list.input_filled ||
+	       gesture_state_machine_pending() ||
+	       touchpanel_raw.next < touchpanel_raw.count || touchpanel_raw.full;
+}
+
+/*
+ * Bulk version of touchpanel_get_event(): fills events with up to maxEvents
+ * events and stops early once there is no more input. Every event must be
+ * released with touchpanel_release_event().
+ *
+ * Registered as NYX_GET_EVENTS_MODULE_METHOD with versions of nyx-lib that
+ * have it.
+ */
+nyx_error_t touchpanel_get_events(nyx_device_t *d, nyx_event_t **events,
+                                  int maxEvents, int *numEvents)
+{
+	int idleCalls = 0;
+
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == events || NULL == numEvents || maxEvents < 0)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	*numEvents = 0;
+
+	/*
+	 * A call comes back empty when the input it handled didn't complete a
+	 * frame, so only give up once nothing is pending. The limit keeps a
+	 * device that never sends EV_SYN from holding the caller forever.
+	 */
+	while (*numEvents < maxEvents && idleCalls < (int)MAX_HIDD_EVENTS)
+	{
+		nyx_event_t *event = NULL;
+		nyx_error_t error = touchpanel_get_event(d, &event);
+
+		if (NYX_ERROR_NONE != error)
+		{
+			return *numEvents ? NYX_ERROR_NONE : error;
+		}
+
+		if (NULL != event)
+		{
+			events[(*numEvents)++] = event;
+			idleCalls = 0;
+		}
+		else if (!touchpanel_input_pending())
+		{
+			break;
+		}
+		else
+		{
+			idleCalls++;
+		}
+	}
 
 	return NYX_ERROR_NONE;
 }
@@ -816,12 +1992,45 @@ nyx_error_t touchpanel_get_idle_scan_rate(nyx_device_t *d, unsigned int *r)
 	return NYX_ERROR_NOT_IMPLEMENTED;
 }
 
+/*
+ * Selects between gesture recognition and raw contacts, m is one of the
+ * touchpanel_mode_t of touchpanel.h. A touch that is in progress finishes in
+ * the old mode.
+ */
 nyx_error_t touchpanel_set_mode(nyx_device_t *d, int m)
 {
-	return NYX_ERROR_NOT_IMPLEMENTED;
+	touchpanel_device_t *touch_device = (touchpanel_device_t *) d;
+
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (m != TOUCHPANEL_MODE_GESTURES && m != TOUCHPANEL_MODE_RAW)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	g_atomic_int_set(&touch_device->mode, m);
+
+	return NYX_ERROR_NONE;
 }
 
 nyx_error_t touchpanel_get_mode(nyx_device_t *d, int *m)
 {
-	return NYX_ERROR_NOT_IMPLEMENTED;
+	touchpanel_device_t *touch_device = (touchpanel_device_t *) d;
+
+	if (NULL == d)
+	{
+		return NYX_ERROR_INVALID_HANDLE;
+	}
+
+	if (NULL == m)
+	{
+		return NYX_ERROR_INVALID_VALUE;
+	}
+
+	*m = g_atomic_int_get(&touch_device->mode);
+
+	return NYX_ERROR_NONE;
 }
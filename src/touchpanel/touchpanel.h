@@ -0,0 +1,50 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Methods of the touchpanel module beyond those of every nyx touchpanel
+ * module, and the values they take.
+ */
+
+#ifndef __TOUCHPANEL_H
+#define __TOUCHPANEL_H
+
+#include <nyx/nyx_module.h>
+
+/*
+ * Modes for touchpanel_set_mode(). Raw mode reports the contacts of the
+ * device without running the gesture engine, for consumers that recognize
+ * gestures themselves.
+ */
+typedef enum
+{
+	TOUCHPANEL_MODE_GESTURES = 0,
+	TOUCHPANEL_MODE_RAW = 1
+} touchpanel_mode_t;
+
+/*
+ * Finger of the touch items that report a gesture of several fingers, such
+ * as a pinch or an edge swipe, rather than a contact. Contacts are numbered
+ * from 0 in steps of 1000, so this never names one of them.
+ */
+#define TOUCHPANEL_GESTURE_ITEM_FINGER  (-1)
+
+nyx_error_t touchpanel_get_events(nyx_device_t *d, nyx_event_t **events,
+                                  int maxEvents, int *numEvents);
+nyx_error_t touchpanel_set_mode(nyx_device_t *d, int m);
+nyx_error_t touchpanel_get_mode(nyx_device_t *d, int *m);
+
+#endif  /* __TOUCHPANEL_H */
@@ -21,8 +21,8 @@
 #include "msgid.h"
 
 void
-set_event_params(input_event_t *pEvent, time_stamp_t *pTime, uint16_t type,
-                 uint16_t code, int32_t value)
+set_event_params(input_event_t *pEvent, const time_stamp_t *pTime,
+                 uint16_t type, uint16_t code, int32_t value)
 {
 	if (NULL == pEvent || NULL == pTime)
 	{
@@ -30,12 +30,17 @@ set_event_params(input_event_t *pEvent, time_stamp_t *pTime, uint16_t type,
 		return;
 	}
 
-	((struct timeval *)pTime)->tv_sec = ((struct timeval *)
-	                                     &pEvent->time)->tv_sec;
-	((struct timeval *)pTime)->tv_usec = ((struct timeval *)
-	                                      &pEvent->time)->tv_usec;
+	pEvent->time.tv_sec = pTime->time.tv_sec;
+	pEvent->time.tv_usec = pTime->time.tv_nsec / 1000;
 
 	pEvent->type = type;
 	pEvent->code = code;
 	pEvent->value = value;
 }
+
+int
+time_stamp_diff_ms(const time_stamp_t *pLater, const time_stamp_t *pEarlier)
+{
+	return (int)((pLater->time.tv_sec - pEarlier->time.tv_sec) * 1000 +
+	             (pLater->time.tv_nsec - pEarlier->time.tv_nsec) / 1000000);
+}
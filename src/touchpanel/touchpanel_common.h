@@ -17,8 +17,10 @@
 #ifndef __TOUCHPANEL_COMMON_H
 #define __TOUCHPANEL_COMMON_H
 
-void set_event_params(input_event_t *pEvent, time_stamp_t *pTime, uint16_t type,
-                      uint16_t code, int32_t value);
+void set_event_params(input_event_t *pEvent, const time_stamp_t *pTime,
+                      uint16_t type, uint16_t code, int32_t value);
+int time_stamp_diff_ms(const time_stamp_t *pLater,
+                       const time_stamp_t *pEarlier);
 
 #endif  /* __TOUCHPANEL_COMMON_PRV_H */
 
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <math.h>
+
+#include "touchpanel_filter.h"
+
+/* used when two samples carry the same time stamp */
+#define MIN_SAMPLE_INTERVAL     0.001
+
+/* smoothing factor of a first order low pass filter */
+static double
+smoothing_factor(double cutoff, double dt)
+{
+	double tau = 1.0 / (2.0 * M_PI * cutoff);
+
+	return 1.0 / (1.0 + tau / dt);
+}
+
+void
+one_euro_filter_reset(one_euro_filter_t *pFilter)
+{
+	pFilter->initialized = false;
+}
+
+/**
+ *******************************************************************************
+ * @brief Filter the next sample of a signal
+ *
+ * @param  pFilter      IN/OUT  filter state of the signal
+ * @param  value        IN      the sample
+ * @param  pTime        IN      time of the sample
+ * @param  pSettings    IN      filter parameters
+ *
+ * @retval the filtered sample
+ *******************************************************************************
+ */
+double
+one_euro_filter_apply(one_euro_filter_t *pFilter, double value,
+                      const time_stamp_t *pTime,
+                      const general_settings_t *pSettings)
+{
+	double dt, derivative, cutoff;
+
+	if (!pFilter->initialized)
+	{
+		pFilter->initialized = true;
+		pFilter->value = value;
+		pFilter->derivative = 0.0;
+		pFilter->time = *pTime;
+		return value;
+	}
+
+	dt = (pTime->time.tv_sec - pFilter->time.time.tv_sec) +
+	     (pTime->time.tv_nsec - pFilter->time.time.tv_nsec) / 1e9;
+
+	if (dt < MIN_SAMPLE_INTERVAL)
+	{
+		dt = MIN_SAMPLE_INTERVAL;
+	}
+
+	derivative = (value - pFilter->value) / dt;
+	pFilter->derivative += smoothing_factor(pSettings->filterDerivativeCutoff,
+	                                        dt) * (derivative - pFilter->derivative);
+
+	cutoff = pSettings->filterMinCutoff + pSettings->filterBeta * fabs(
+	             pFilter->derivative);
+	pFilter->value += smoothing_factor(cutoff, dt) * (value - pFilter->value);
+	pFilter->time = *pTime;
+
+	return pFilter->value;
+}
@@ -0,0 +1,32 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __TOUCHPANEL_FILTER_H
+#define __TOUCHPANEL_FILTER_H
+
+#include "touchpanel_gestures.h"
+
+/*
+ * 1 euro filter (Casiez, Roussel, Vogel, CHI 2012): a low pass filter whose
+ * cutoff frequency rises with the speed of the signal, so slow movements are
+ * smoothed strongly and fast ones get little lag.
+ */
+void one_euro_filter_reset(one_euro_filter_t *pFilter);
+double one_euro_filter_apply(one_euro_filter_t *pFilter, double value,
+                             const time_stamp_t *pTime,
+                             const general_settings_t *pSettings);
+
+#endif  /* __TOUCHPANEL_FILTER_H */
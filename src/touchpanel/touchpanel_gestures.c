@@ -16,7 +16,10 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <math.h>
 #include <glib-2.0/glib.h>
 
 #include <nyx/module/nyx_log.h>
@@ -24,6 +27,8 @@
 
 #include "touchpanel_gestures.h"
 #include "touchpanel_common.h"
+#include "touchpanel_filter.h"
+#include "touchpanel_trace.h"
 #include "msgid.h"
 
 static GList *sFingers = NULL;
@@ -31,11 +36,59 @@ static GQueue availableFingers = G_QUEUE_INIT;
 
 static uint32_t curFingerId = 0;
 
-int gesture_state_machine_finger(finger_t *finger, input_event_t *events,
-                                 int *numEvents);
+int gesture_state_machine_finger(finger_t *finger);
+static void gesture_state_machine_multi_finger(const time_stamp_t *pCurTime);
+static void emit_gesture_item(const time_stamp_t *pTime, gesture_key_t key,
+                              const double *centroid);
 
 static const general_settings_t *spGeneralSettings = NULL;
 
+/* display size in px, 0 while unknown */
+static int sScreenWidth = 0;
+static int sScreenHeight = 0;
+
+/*
+ * Events are written straight into the caller's buffer. Whatever doesn't fit
+ * is kept in the spill buffer until the caller fetches it with
+ * gesture_state_machine_resume(), and only what doesn't fit there either is
+ * lost.
+ */
+#define MAX_EVENTS_PER_FINGER       10
+#define MAX_EVENTS_MULTI_FINGER     15
+
+static struct
+{
+	input_event_t *events;
+	int maxEvents;
+	int numEvents;
+	int frameEvents;            /**< events of the current frame, wherever they went */
+	int dropped;
+} sOut;
+
+static input_event_t *spSpill = NULL;
+static int sSpillSize = 0;
+static int sSpillHead = 0;
+static int sSpillCount = 0;
+
+/* geometry of the finger pair in the previous frame */
+static struct
+{
+	bool valid;
+	uint32_t ids[2];
+	double centroid[NUM_DIMENSIONS];
+	double distance;
+	double angle;
+} sFingerPair;
+
+/* the last reported tap, to pair it with the next one into a double tap */
+static struct
+{
+	bool valid;
+	int x;
+	int y;
+	time_stamp_t time;
+} sLastTap;
+
 /**
  *******************************************************************************
  * @brief Allocate and initialize the buffer that keeps a coordinate history
@@ -74,6 +127,47 @@ create_coord_buffer(coord_buf_t *pCoordBuf, int bufSize)
 }
 
 
+/**
+ *******************************************************************************
+ * @brief Change the size of a coordinate buffer, keeping the most recent
+ *        coordinates
+ *
+ * @param  pCoordBuf    IN/OUT  ptr to the coordinate buffer struct
+ * @param  bufSize      IN      new size of the buffer
+ *
+ * @retval  0 on success
+ * @retval -1 on failure, the buffer is left as it was
+ *******************************************************************************
+ */
+int
+resize_coord_buffer(coord_buf_t *pCoordBuf, int bufSize)
+{
+	int numItems = MIN(pCoordBuf->numItems, bufSize);
+	coord_t *pCoords = (coord_t *)malloc(sizeof(coord_t) * bufSize);
+	int i;
+
+	if (NULL == pCoords)
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_COORDS_ERR, 0,"Failed to allocate memory");
+		return -1;
+	}
+
+	for (i = 0; i < numItems; i++)
+	{
+		pCoords[i] = pCoordBuf->pCoords[(pCoordBuf->head + pCoordBuf->numItems -
+		                                 numItems + i) % pCoordBuf->size];
+	}
+
+	free(pCoordBuf->pCoords);
+	pCoordBuf->pCoords = pCoords;
+	pCoordBuf->size = bufSize;
+	pCoordBuf->head = 0;
+	pCoordBuf->tail = numItems % bufSize;
+	pCoordBuf->numItems = numItems;
+
+	return 0;
+}
+
 void
 free_coord_buffer(coord_buf_t *pCoordBuf)
 {
@@ -103,41 +197,6 @@ update_coord_buffer(coord_buf_t *pCoordBuf, int xCoord, int yCoord,
 	int index = pCoordBuf->tail;
 	coord_t *pCurCoord = &((pCoordBuf->pCoords)[index]);
 
-	if (spGeneralSettings->positionFilter && pCoordBuf->numItems)
-	{
-		int prev;
-
-		if (index)
-		{
-			prev = index - 1;
-		}
-
-		else
-		{
-			prev = pCoordBuf->size - 1;
-		}
-
-		if (xCoord < pCoordBuf->pCoords[prev].x)
-		{
-			xCoord++;
-		}
-
-		else if (xCoord > pCoordBuf->pCoords[prev].x)
-		{
-			xCoord--;
-		}
-
-		if (yCoord < pCoordBuf->pCoords[prev].y)
-		{
-			yCoord++;
-		}
-
-		else if (yCoord > pCoordBuf->pCoords[prev].y)
-		{
-			yCoord--;
-		}
-	}
-
 	pCurCoord->timeStamp = *pTime;
 	pCurCoord->x = xCoord;
 	pCurCoord->y = yCoord;
@@ -150,6 +209,25 @@ update_coord_buffer(coord_buf_t *pCoordBuf, int xCoord, int yCoord,
 	pCoordBuf->tail = (pCoordBuf->tail + 1) % pCoordBuf->size;
 }
 
+/*
+ * Adds the new coordinates of a finger to its history, smoothing them first
+ * if the position filter is enabled.
+ */
+static void
+update_finger_coords(finger_t *finger, int xCoord, int yCoord,
+                     const time_stamp_t *pTime)
+{
+	if (spGeneralSettings->positionFilter)
+	{
+		xCoord = (int)lround(one_euro_filter_apply(&finger->filter[X_DIM], xCoord,
+		                     pTime, spGeneralSettings));
+		yCoord = (int)lround(one_euro_filter_apply(&finger->filter[Y_DIM], yCoord,
+		                     pTime, spGeneralSettings));
+	}
+
+	update_coord_buffer(&finger->coords, xCoord, yCoord, pTime);
+}
+
 void get_last_coords(const coord_buf_t *pCoordBuf, int *xCoord, int *yCoord,
                      time_stamp_t *timestamp)
 {
@@ -172,12 +250,112 @@ void get_last_coords(const coord_buf_t *pCoordBuf, int *xCoord, int *yCoord,
 	}
 }
 
+static void
+flush_spill(void)
+{
+	int n = MIN(sSpillCount, sOut.maxEvents - sOut.numEvents);
+
+	if (n <= 0)
+	{
+		return;
+	}
+
+	memcpy(&sOut.events[sOut.numEvents], &spSpill[sSpillHead],
+	       n * sizeof(input_event_t));
+	sOut.numEvents += n;
+	sSpillHead += n;
+	sSpillCount -= n;
+
+	if (sSpillCount == 0)
+	{
+		sSpillHead = 0;
+	}
+}
+
+static void
+emit_begin(input_event_t *events, int maxEvents)
+{
+	sOut.events = events;
+	sOut.maxEvents = maxEvents;
+	sOut.numEvents = 0;
+	sOut.frameEvents = 0;
+	sOut.dropped = 0;
+
+	/* events left over from earlier frames go out first */
+	flush_spill();
+}
+
+static void
+emit_event(const time_stamp_t *pTime, uint16_t type, uint16_t code,
+           int32_t value)
+{
+	sOut.frameEvents++;
+
+	if (sSpillCount == 0 && sOut.numEvents < sOut.maxEvents)
+	{
+		set_event_params(&sOut.events[sOut.numEvents++], pTime, type, code, value);
+		return;
+	}
+
+	if (sSpillHead + sSpillCount == sSpillSize && sSpillHead > 0)
+	{
+		memmove(spSpill, &spSpill[sSpillHead], sSpillCount * sizeof(input_event_t));
+		sSpillHead = 0;
+	}
+
+	if (sSpillHead + sSpillCount < sSpillSize)
+	{
+		set_event_params(&spSpill[sSpillHead + sSpillCount++], pTime, type, code,
+		                 value);
+		return;
+	}
+
+	sOut.dropped++;
+}
+
+static gesture_emit_status_t
+emit_end(int *numEvents)
+{
+	*numEvents = sOut.numEvents;
+
+	if (sOut.dropped)
+	{
+		TP_TRACE_INFO(TP_TRACE_EVENTS_DROPPED, MSGID_NYX_QMUX_TP_EVENTS_DROPPED,
+		              "Dropped %d events, output buffer too small", sOut.dropped);
+		return GESTURE_EMIT_TRUNCATED;
+	}
+
+	if (sSpillCount)
+	{
+		TP_TRACE_VERBOSE(TP_TRACE_EVENTS_DEFERRED, "%d events deferred",
+		                 sSpillCount);
+		return GESTURE_EMIT_PENDING;
+	}
+
+	return GESTURE_EMIT_OK;
+}
+
 void init_gesture_state_machine(const general_settings_t *pGeneralSettings,
                                 int maxFingers)
 {
 	int i;
 
 	spGeneralSettings = pGeneralSettings;
+	sLastTap.valid = false;
+	sFingerPair.valid = false;
+
+	/* room for two worst case frames: the pending one and the next one */
+	sSpillSize = 2 * (maxFingers * 2 * MAX_EVENTS_PER_FINGER +
+	                  MAX_EVENTS_MULTI_FINGER + 1);
+	sSpillHead = 0;
+	sSpillCount = 0;
+	spSpill = malloc(sSpillSize * sizeof(input_event_t));
+
+	if (NULL == spSpill)
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_COORDS_ERR, 0, "Failed to allocate memory");
+		sSpillSize = 0;
+	}
 
 	for (i = 0 ; i < maxFingers * 2; i++)
 	{
@@ -194,6 +372,11 @@ deinit_gesture_state_machine(void)
 {
 	finger_t *finger = NULL;
 
+	free(spSpill);
+	spSpill = NULL;
+	sSpillSize = 0;
+	sSpillCount = 0;
+
 	while ((finger = g_queue_pop_head(&availableFingers)) != NULL)
 	{
 		free_coord_buffer(&finger->coords);
@@ -226,6 +409,7 @@ reset_state_data(gesture_state_data_t *pStateData)
 {
 	pStateData->state = START_STATE;
 	pStateData->insideTapRadius = true;
+	pStateData->edge = EDGE_NONE;
 }
 
 static void add_new_finger(int x, int y, int weight,
@@ -235,7 +419,8 @@ static void add_new_finger(int x, int y, int weight,
 
 	if (!finger)
 	{
-		nyx_debug("No available finger buffers, rejecting finger");
+		TP_TRACE_DEBUG(TP_TRACE_FINGER_REJECTED,
+		               "No available finger buffers, rejecting finger");
 		return;
 	}
 
@@ -248,33 +433,109 @@ static void add_new_finger(int x, int y, int weight,
 	finger->minDistId = 0;
 	finger->lastWeight = weight;
 	reset_coord_buffer(&finger->coords);
-	update_coord_buffer(&finger->coords, x, y, pCurTime);
-	nyx_debug("Finger down at %d,%d", x, y);
+	one_euro_filter_reset(&finger->filter[X_DIM]);
+	one_euro_filter_reset(&finger->filter[Y_DIM]);
+	update_finger_coords(finger, x, y, pCurTime);
+	TP_TRACE_VERBOSE(TP_TRACE_FINGER_DOWN, "Finger down at %d,%d", x, y);
 	sFingers = g_list_prepend(sFingers, finger);
 }
 
 
-#define MAX_EVENTS_PER_UPDATE 100
+/*
+ * Palm and edge rejection:
+ * The panel only reports a weight per contact, which grows with the contact
+ * area, so that is what tells a palm from a finger. A contact that is too
+ * heavy is dropped whether or not it is tracked already, which releases a
+ * finger a palm lands on.
+ */
+static bool
+is_palm(int weight)
+{
+	return spGeneralSettings->palmWeightThreshold > 0 &&
+	       weight >= spGeneralSettings->palmWeightThreshold;
+}
+
+static bool
+in_edge_zone(int x, int y)
+{
+	int width = spGeneralSettings->edgeRejectWidth;
+
+	if (width <= 0 || sScreenWidth <= 0 || sScreenHeight <= 0)
+	{
+		return false;
+	}
+
+	return x < width || y < width || x >= sScreenWidth - width ||
+	       y >= sScreenHeight - width;
+}
+
+/*
+ * A hand holding the device rests its thumb on the edge of the screen while
+ * the other hand touches it. New contacts in the edge zone are therefore
+ * dropped as long as a finger is down outside of it. A lone contact at the
+ * edge is kept, it is most likely meant.
+ */
+static bool
+reject_new_contact(int x, int y, int weight, int numInside)
+{
+	if (is_palm(weight))
+	{
+		TP_TRACE_DEBUG(TP_TRACE_PALM_REJECTED, "Rejecting palm at %d,%d weight: %d",
+		               x, y, weight);
+		return true;
+	}
+
+	if (numInside > 0 && in_edge_zone(x, y))
+	{
+		TP_TRACE_DEBUG(TP_TRACE_EDGE_REJECTED, "Rejecting edge contact at %d,%d",
+		               x, y);
+		return true;
+	}
+
+	return false;
+}
 
 /*
  * Finger tracking:
  * The hardware does not do any fingertracking, so we do it all here.
+ *
+ * At most maxEvents events are written to events, see
+ * gesture_emit_status_t for what happens to the rest.
  */
-void
+gesture_emit_status_t
 gesture_state_machine(int *pXCoords, int *pYCoords, const int *pFingerWeights,
                       int numFingers, const time_stamp_t *pCurTime,
-                      input_event_t *events, int *numEvents)
+                      input_event_t *events, int maxEvents, int *numEvents)
 {
 	/* Update Fingers */
 	int j;
 	int timestmpcnt = 0;
+	int numInside = 0;
 	GList *list;
 
+	emit_begin(events, maxEvents);
+
+	//Count the contacts that may hold edge contacts off, before the matched
+	//ones get cleared below
+	for (j = 0; j < numFingers; j++)
+	{
+		if (!is_palm(pFingerWeights[j]) && !in_edge_zone(pXCoords[j], pYCoords[j]))
+		{
+			numInside++;
+		}
+	}
+
 	//For each new finger
 	for (j = 0; j < numFingers; j++)
 	{
 		int minDist = INT_MAX;
 		GList *minId = NULL;
+
+		if (is_palm(pFingerWeights[j]))
+		{
+			continue;
+		}
+
 		list = g_list_first(sFingers);
 
 		//Try and match it against one of the existing ones
@@ -336,20 +597,22 @@ gesture_state_machine(int *pXCoords, int *pYCoords, const int *pFingerWeights,
 			continue;
 		}
 
-		nyx_info(MSGID_NYX_QMUX_TP_FINGER_WT, 0,"New coord (at: %d), %d,%d weight: %d, distance: %d",
-		         finger->minDistId, pXCoords[finger->minDistId], pYCoords[finger->minDistId],
-		         pFingerWeights[finger->minDistId], finger->minDist);
+		TP_TRACE_VERBOSE(TP_TRACE_FINGER_MATCHED,
+		                 "New coord (at: %d), %d,%d weight: %d, distance: %d",
+		                 finger->minDistId, pXCoords[finger->minDistId],
+		                 pYCoords[finger->minDistId], pFingerWeights[finger->minDistId],
+		                 finger->minDist);
 
 		//Let's ignore the coordinate if there was a huge difference in weight
 		//This is a common scenario when the user is releasing his finger.
 		if (finger->lastWeight / 2 < pFingerWeights[finger->minDistId])
 		{
-			update_coord_buffer(&finger->coords, pXCoords[finger->minDistId],
-			                    pYCoords[finger->minDistId], pCurTime);
+			update_finger_coords(finger, pXCoords[finger->minDistId],
+			                     pYCoords[finger->minDistId], pCurTime);
 		}
 		else
 		{
-			nyx_debug("Ignoring coordinate");
+			TP_TRACE_DEBUG(TP_TRACE_COORD_IGNORED, "Ignoring coordinate");
 		}
 
 		finger->lastWeight = pFingerWeights[finger->minDistId];
@@ -378,14 +641,20 @@ gesture_state_machine(int *pXCoords, int *pYCoords, const int *pFingerWeights,
 		if (pFingerWeights[j] < g_atomic_int_get(
 		            &spGeneralSettings->fingerDownThreshold))
 		{
-			nyx_info(MSGID_NYX_QMUX_TP_FING_LOW_WT, 0,"Discarding finger with too low weight (%d)", pFingerWeights[j]);
+			TP_TRACE_INFO(TP_TRACE_FINGER_LOW_WEIGHT, MSGID_NYX_QMUX_TP_FING_LOW_WT,
+			              "Discarding finger with too low weight (%d)", pFingerWeights[j]);
 			continue;
 		}
 
-		nyx_debug("pFingerWeight: %d (%d)", pFingerWeights[j], j);
+		if (reject_new_contact(pXCoords[j], pYCoords[j], pFingerWeights[j],
+		                       numInside))
+		{
+			continue;
+		}
 
-		nyx_debug("j: %d, %d) New finger @ %d,%d", j, numFingers, pXCoords[j],
-		         pYCoords[j]);
+		TP_TRACE_VERBOSE(TP_TRACE_FINGER_NEW,
+		                 "j: %d, %d) New finger @ %d,%d weight: %d", j, numFingers,
+		                 pXCoords[j], pYCoords[j], pFingerWeights[j]);
 
 		ts.time.tv_nsec += timestmpcnt;
 		timestmpcnt += 1000000;
@@ -400,7 +669,7 @@ gesture_state_machine(int *pXCoords, int *pYCoords, const int *pFingerWeights,
 		finger_t *finger = (finger_t *)list->data;
 
 		//-1 means to move the list element into the available list
-		if (gesture_state_machine_finger(finger, events, numEvents) == -1)
+		if (gesture_state_machine_finger(finger) == -1)
 		{
 			finger->state.state = UNUSED;
 			list = g_list_next(list);
@@ -413,28 +682,310 @@ gesture_state_machine(int *pXCoords, int *pYCoords, const int *pFingerWeights,
 		}
 	}
 
-	if (0 < *numEvents)
+	gesture_state_machine_multi_finger(pCurTime);
+
+	if (0 < sOut.frameEvents)
 	{
-		//ASSERT(numEvents < MAX_EVENTS_PER_UPDATE);
 		/* add EV_SYN event */
-		set_event_params(&events[(*numEvents)++], (time_stamp_t *) pCurTime, EV_SYN, 0,
-		                 0);
+		emit_event(pCurTime, EV_SYN, 0, 0);
+	}
+
+	return emit_end(numEvents);
+}
+
+/**
+ *******************************************************************************
+ * @brief Fetch the events that didn't fit the buffer of an earlier call
+ *
+ * @param  events       OUT     buffer for the events
+ * @param  maxEvents    IN      capacity of the buffer
+ * @param  numEvents    OUT     number of events written to the buffer
+ *
+ * @retval GESTURE_EMIT_OK if all pending events were written
+ * @retval GESTURE_EMIT_PENDING if some are still pending
+ *******************************************************************************
+ */
+gesture_emit_status_t
+gesture_state_machine_resume(input_event_t *events, int maxEvents,
+                             int *numEvents)
+{
+	emit_begin(events, maxEvents);
+
+	return emit_end(numEvents);
+}
+
+int
+gesture_state_machine_pending(void)
+{
+	return sSpillCount;
+}
+
+static void
+emit_gesture(const time_stamp_t *pTime, gesture_key_t key)
+{
+	emit_event(pTime, EV_GESTURE, GESTURE_CODE_KEY, key);
+}
+
+/*
+ * Velocity of the finger over the samples kept in its coordinate buffer,
+ * in px/s. Returns false if the samples don't span any time.
+ */
+static bool
+get_finger_velocity(const finger_t *finger, int *xVelocity, int *yVelocity)
+{
+	const coord_buf_t *pCoordBuf = &finger->coords;
+	const coord_t *first = &pCoordBuf->pCoords[pCoordBuf->head];
+	const coord_t *last = &pCoordBuf->pCoords[(pCoordBuf->head +
+	                      pCoordBuf->numItems - 1) % pCoordBuf->size];
+	int dt = time_stamp_diff_ms(&last->timeStamp, &first->timeStamp);
+
+	if (dt <= 0)
+	{
+		return false;
+	}
+
+	*xVelocity = (last->x - first->x) * 1000 / dt;
+	*yVelocity = (last->y - first->y) * 1000 / dt;
+
+	return true;
+}
+
+/*
+ * Timer driven part of the recognizer: keeps track of the finger leaving the
+ * tap radius and reports a long press once the finger has been held inside
+ * it for long enough.
+ */
+static void
+update_finger_timers(finger_t *finger, int x, int y, const time_stamp_t *pTime)
+{
+	gesture_state_data_t *pState = &finger->state;
+
+	if (pState->state != FINGER_DOWN_STATE)
+	{
+		return;
+	}
+
+	if (pState->insideTapRadius)
+	{
+		int dx = x - pState->start[X_DIM];
+		int dy = y - pState->start[Y_DIM];
+
+		if (dx * dx + dy * dy > spGeneralSettings->tapRadius *
+		        spGeneralSettings->tapRadius)
+		{
+			pState->insideTapRadius = false;
+		}
+	}
+
+	if (pState->insideTapRadius &&
+	        time_stamp_diff_ms(pTime, &pState->startTime) >=
+	        spGeneralSettings->longPressTimeout)
+	{
+		TP_TRACE_DEBUG(TP_TRACE_GESTURE, "Long press at %d,%d", x, y);
+		emit_gesture(pTime, GESTURE_KEY_LONG_PRESS);
+		pState->state = FINGER_DOWN_AFTER_LONG_PRESS;
+	}
+}
+
+/*
+ * Edge the finger went down at, if any. The zone is a share of the screen
+ * size, so it covers the same physical margin at any resolution. In a corner
+ * the closer edge wins.
+ */
+static screen_edge_t
+find_start_edge(int x, int y)
+{
+	int zoneX = spGeneralSettings->edgeSwipeZone * sScreenWidth / 100;
+	int zoneY = spGeneralSettings->edgeSwipeZone * sScreenHeight / 100;
+	int distance[] =
+	{
+		[EDGE_LEFT] = x,
+		[EDGE_RIGHT] = sScreenWidth - 1 - x,
+		[EDGE_TOP] = y,
+		[EDGE_BOTTOM] = sScreenHeight - 1 - y,
+	};
+	screen_edge_t edge = EDGE_NONE;
+	int i;
+
+	if (spGeneralSettings->edgeSwipeZone <= 0 || sScreenWidth <= 0 ||
+	        sScreenHeight <= 0)
+	{
+		return EDGE_NONE;
+	}
+
+	for (i = EDGE_LEFT; i <= EDGE_BOTTOM; i++)
+	{
+		int zone = (i == EDGE_LEFT || i == EDGE_RIGHT) ? zoneX : zoneY;
+
+		if (distance[i] < zone && (edge == EDGE_NONE ||
+		                           distance[i] < distance[edge]))
+		{
+			edge = i;
+		}
+	}
+
+	return edge;
+}
+
+/*
+ * Reports an edge swipe once a finger that went down at an edge has moved
+ * far enough away from it, mostly straight, and within the timeout. Returns
+ * true if it did, the gesture item itself is emitted by the caller.
+ */
+static bool
+recognize_edge_swipe(finger_t *finger, int x, int y, const time_stamp_t *pTime)
+{
+	gesture_state_data_t *pState = &finger->state;
+	int dx = x - pState->start[X_DIM];
+	int dy = y - pState->start[Y_DIM];
+	int inward, across, distance;
+
+	if (pState->state != FINGER_DOWN_STATE || pState->edge == EDGE_NONE)
+	{
+		return false;
+	}
+
+	if (time_stamp_diff_ms(pTime, &pState->startTime) >
+	        spGeneralSettings->edgeSwipeTimeout)
+	{
+		pState->edge = EDGE_NONE;
+		return false;
+	}
+
+	switch (pState->edge)
+	{
+		case EDGE_LEFT:
+			inward = dx;
+			across = dy;
+			distance = sScreenWidth;
+			break;
+
+		case EDGE_RIGHT:
+			inward = -dx;
+			across = dy;
+			distance = sScreenWidth;
+			break;
+
+		case EDGE_TOP:
+			inward = dy;
+			across = dx;
+			distance = sScreenHeight;
+			break;
+
+		default:
+			inward = -dy;
+			across = dx;
+			distance = sScreenHeight;
+			break;
+	}
+
+	distance = spGeneralSettings->edgeSwipeDistance * distance / 100;
+
+	if (inward < distance || inward <= abs(across))
+	{
+		return false;
+	}
+
+	TP_TRACE_DEBUG(TP_TRACE_GESTURE, "Edge swipe from edge %d at %d,%d",
+	               pState->edge, x, y);
+	pState->state = FINGER_DOWN_AFTER_EDGE_SWIPE;
+	return true;
+}
+
+static void
+emit_edge_swipe(const finger_t *finger, int x, int y, const time_stamp_t *pTime)
+{
+	static const gesture_key_t keys[] =
+	{
+		[EDGE_LEFT] = GESTURE_KEY_EDGE_SWIPE_LEFT,
+		[EDGE_RIGHT] = GESTURE_KEY_EDGE_SWIPE_RIGHT,
+		[EDGE_TOP] = GESTURE_KEY_EDGE_SWIPE_TOP,
+		[EDGE_BOTTOM] = GESTURE_KEY_EDGE_SWIPE_BOTTOM,
+	};
+	double position[NUM_DIMENSIONS] = { x, y };
+	int xVelocity = 0, yVelocity = 0;
+
+	get_finger_velocity(finger, &xVelocity, &yVelocity);
+	emit_gesture_item(pTime, keys[finger->state.edge], position);
+	emit_event(pTime, EV_GESTURE, GESTURE_CODE_VEL_X, xVelocity);
+	emit_event(pTime, EV_GESTURE, GESTURE_CODE_VEL_Y, yVelocity);
+}
+
+/*
+ * Classifies a finger that is being released as a tap, double tap or flick.
+ */
+static void
+recognize_release(finger_t *finger, int x, int y, const time_stamp_t *pTime)
+{
+	gesture_state_data_t *pState = &finger->state;
+	int xVelocity, yVelocity;
+
+	if (pState->state != FINGER_DOWN_STATE)
+	{
+		sLastTap.valid = false;
+		return;
+	}
+
+	if (pState->insideTapRadius)
+	{
+		if (time_stamp_diff_ms(pTime, &pState->startTime) >
+		        spGeneralSettings->tapTimeout)
+		{
+			sLastTap.valid = false;
+			return;
+		}
+
+		int dx = x - sLastTap.x;
+		int dy = y - sLastTap.y;
+
+		if (sLastTap.valid &&
+		        time_stamp_diff_ms(pTime, &sLastTap.time) <=
+		        spGeneralSettings->doubleTapTimeout &&
+		        dx * dx + dy * dy <= spGeneralSettings->doubleTapRadius *
+		        spGeneralSettings->doubleTapRadius)
+		{
+			TP_TRACE_DEBUG(TP_TRACE_GESTURE, "Double tap at %d,%d", x, y);
+			emit_gesture(pTime, GESTURE_KEY_DOUBLE_TAP);
+			sLastTap.valid = false;
+		}
+		else
+		{
+			TP_TRACE_DEBUG(TP_TRACE_GESTURE, "Tap at %d,%d", x, y);
+			emit_gesture(pTime, GESTURE_KEY_TAP);
+			sLastTap.valid = true;
+			sLastTap.x = x;
+			sLastTap.y = y;
+			sLastTap.time = *pTime;
+		}
+
+		return;
+	}
+
+	sLastTap.valid = false;
+
+	if (get_finger_velocity(finger, &xVelocity, &yVelocity) &&
+	        (int64_t)xVelocity * xVelocity + (int64_t)yVelocity * yVelocity >=
+	        (int64_t)spGeneralSettings->flickMinVelocity *
+	        spGeneralSettings->flickMinVelocity)
+	{
+		TP_TRACE_DEBUG(TP_TRACE_GESTURE, "Flick at %d,%d (%d,%d px/s)", x, y,
+		               xVelocity, yVelocity);
+		emit_gesture(pTime, GESTURE_KEY_FLICK);
+		emit_event(pTime, EV_GESTURE, GESTURE_CODE_VEL_X, xVelocity);
+		emit_event(pTime, EV_GESTURE, GESTURE_CODE_VEL_Y, yVelocity);
 	}
 }
 
-int gesture_state_machine_finger(finger_t *finger, input_event_t *events,
-                                 int *numEvents)
+int gesture_state_machine_finger(finger_t *finger)
 {
 	int x, y;
 	time_stamp_t timestamp;
+	bool edgeSwipe;
+	int ret = 0;
 
 	get_last_coords(&finger->coords, &x, &y, &timestamp);
 
-	finger->numEvents = *numEvents;
-	finger->events = events;
-
-	set_event_params(&finger->events[finger->numEvents++], &timestamp, EV_FINGERID,
-	                 0 , finger->id);
+	emit_event(&timestamp, EV_FINGERID, 0, finger->id);
 
 	switch (finger->state.state)
 	{
@@ -443,9 +994,9 @@ int gesture_state_machine_finger(finger_t *finger, input_event_t *events,
 			finger->state.start[X_DIM] = x;
 			finger->state.start[Y_DIM] = y;
 			finger->state.startTime = timestamp;
+			finger->state.edge = find_start_edge(x, y);
 			finger->state.state = FINGER_DOWN_STATE;
-			set_event_params(&finger->events[finger->numEvents++], &timestamp, EV_KEY,
-			                 BTN_TOUCH, 1);
+			emit_event(&timestamp, EV_KEY, BTN_TOUCH, 1);
 		}
 		break;
 
@@ -453,6 +1004,9 @@ int gesture_state_machine_finger(finger_t *finger, input_event_t *events,
 			break;
 
 		case FINGER_DOWN_AFTER_QUICK_LAUNCH:
+		case FINGER_DOWN_AFTER_LONG_PRESS:
+		case FINGER_DOWN_AFTER_MULTI_FINGER:
+		case FINGER_DOWN_AFTER_EDGE_SWIPE:
 		{
 			/* keep reporting pen moves until the finger comes up
 			 * LunaSysMgr will handle the finger until release
@@ -465,25 +1019,260 @@ int gesture_state_machine_finger(finger_t *finger, input_event_t *events,
 			break;
 	}
 
-	set_event_params(&finger->events[finger->numEvents++], &timestamp, EV_ABS,
-	                 ABS_X, x);
-	set_event_params(&finger->events[finger->numEvents++], &timestamp, EV_ABS,
-	                 ABS_Y, y);
-	*numEvents = finger->numEvents;
+	emit_event(&timestamp, EV_ABS, ABS_X, x);
+	emit_event(&timestamp, EV_ABS, ABS_Y, y);
+	edgeSwipe = recognize_edge_swipe(finger, x, y, &timestamp);
+	update_finger_timers(finger, x, y, &timestamp);
 
 	if (finger->minDist > 0)
 	{
 		//send finger release event
-		nyx_debug("Finger up at %d,%d", x, y);
-		set_event_params(&finger->events[finger->numEvents++], &timestamp, EV_KEY,
-		                 BTN_TOUCH, 0);
-		*numEvents = finger->numEvents;
-		return -1;
+		TP_TRACE_VERBOSE(TP_TRACE_FINGER_UP, "Finger up at %d,%d", x, y);
+		recognize_release(finger, x, y, &timestamp);
+		emit_event(&timestamp, EV_KEY, BTN_TOUCH, 0);
+		ret = -1;
 	}
 	else
 	{
 		finger->minDist = INT_MAX;
 	}
 
-	return 0;
+	/* last, as the gesture item ends the item of the finger */
+	if (edgeSwipe)
+	{
+		emit_edge_swipe(finger, x, y, &timestamp);
+	}
+
+	return ret;
+}
+
+static void
+emit_gesture_item(const time_stamp_t *pTime, gesture_key_t key,
+                  const double *centroid)
+{
+	emit_event(pTime, EV_GESTURE, GESTURE_CODE_ITEM, key);
+	emit_event(pTime, EV_ABS, ABS_X, (int)lround(centroid[X_DIM]));
+	emit_event(pTime, EV_ABS, ABS_Y, (int)lround(centroid[Y_DIM]));
+}
+
+/*
+ * Two finger recognizer: while exactly two fingers are down, reports how
+ * their centroid, distance and angle changed since the previous frame as
+ * pan, pinch and rotate gesture items.
+ */
+static void
+gesture_state_machine_multi_finger(const time_stamp_t *pCurTime)
+{
+	finger_t *pair[2];
+	int coords[2][NUM_DIMENSIONS];
+	double centroid[NUM_DIMENSIONS];
+	double distance, angle;
+	int i;
+
+	if (g_list_length(sFingers) != 2)
+	{
+		sFingerPair.valid = false;
+		return;
+	}
+
+	pair[0] = (finger_t *)sFingers->data;
+	pair[1] = (finger_t *)sFingers->next->data;
+
+	/* keep a stable order so the angle doesn't flip between frames */
+	if (pair[0]->id > pair[1]->id)
+	{
+		finger_t *tmp = pair[0];
+		pair[0] = pair[1];
+		pair[1] = tmp;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		get_last_coords(&pair[i]->coords, &coords[i][X_DIM], &coords[i][Y_DIM],
+		                NULL);
+
+		/* fingers of a pair are never a tap, long press or flick */
+		if (pair[i]->state.state == FINGER_DOWN_STATE)
+		{
+			pair[i]->state.state = FINGER_DOWN_AFTER_MULTI_FINGER;
+		}
+	}
+
+	centroid[X_DIM] = (coords[0][X_DIM] + coords[1][X_DIM]) / 2.0;
+	centroid[Y_DIM] = (coords[0][Y_DIM] + coords[1][Y_DIM]) / 2.0;
+	distance = hypot(coords[1][X_DIM] - coords[0][X_DIM],
+	                 coords[1][Y_DIM] - coords[0][Y_DIM]);
+	angle = atan2(coords[1][Y_DIM] - coords[0][Y_DIM],
+	              coords[1][X_DIM] - coords[0][X_DIM]) * 180.0 / M_PI;
+
+	if (sFingerPair.valid && sFingerPair.ids[0] == pair[0]->id &&
+	        sFingerPair.ids[1] == pair[1]->id)
+	{
+		int dx = (int)lround(centroid[X_DIM] - sFingerPair.centroid[X_DIM]);
+		int dy = (int)lround(centroid[Y_DIM] - sFingerPair.centroid[Y_DIM]);
+		double rotation = angle - sFingerPair.angle;
+
+		if (rotation > 180.0)
+		{
+			rotation -= 360.0;
+		}
+		else if (rotation <= -180.0)
+		{
+			rotation += 360.0;
+		}
+
+		if (dx || dy)
+		{
+			emit_gesture_item(pCurTime, GESTURE_KEY_PAN, centroid);
+			emit_event(pCurTime, EV_GESTURE, GESTURE_CODE_VEL_X, dx);
+			emit_event(pCurTime, EV_GESTURE, GESTURE_CODE_VEL_Y, dy);
+		}
+
+		if (distance != sFingerPair.distance && sFingerPair.distance > 0)
+		{
+			/* fingers that start out next to each other can spread by more
+			   than fits, report as much as does */
+			double scale = MIN(distance / sFingerPair.distance * GESTURE_WEIGHT_SCALE,
+			                   (double) INT32_MAX);
+
+			emit_gesture_item(pCurTime, GESTURE_KEY_PINCH, centroid);
+			emit_event(pCurTime, EV_GESTURE,
+			           GESTURE_CODE_WEIGHT, (int32_t)lround(scale));
+		}
+
+		if (rotation != 0.0)
+		{
+			emit_gesture_item(pCurTime, GESTURE_KEY_ROTATE, centroid);
+			emit_event(pCurTime, EV_GESTURE,
+			           GESTURE_CODE_WEIGHT,
+			           (int32_t)lround(rotation * GESTURE_WEIGHT_SCALE));
+		}
+	}
+
+	sFingerPair.valid = true;
+	sFingerPair.ids[0] = pair[0]->id;
+	sFingerPair.ids[1] = pair[1]->id;
+	sFingerPair.centroid[X_DIM] = centroid[X_DIM];
+	sFingerPair.centroid[Y_DIM] = centroid[Y_DIM];
+	sFingerPair.distance = distance;
+	sFingerPair.angle = angle;
+}
+
+/*
+ * Applies a new coordBufSize to the fingers, including the ones that are down.
+ * Must be called between frames.
+ */
+int
+gesture_state_machine_set_coord_buf_size(int bufSize)
+{
+	int ret = 0;
+	GList *list;
+
+	for (list = sFingers; list; list = g_list_next(list))
+	{
+		ret |= resize_coord_buffer(&((finger_t *)list->data)->coords, bufSize);
+	}
+
+	for (list = availableFingers.head; list; list = g_list_next(list))
+	{
+		ret |= resize_coord_buffer(&((finger_t *)list->data)->coords, bufSize);
+	}
+
+	return ret;
+}
+
+/*
+ * Tells the engine the size of the display the coordinates are scaled to.
+ * Until it is known no contact is treated as an edge contact.
+ */
+void
+gesture_state_machine_set_screen_size(int width, int height)
+{
+	sScreenWidth = width;
+	sScreenHeight = height;
+}
+
+/**
+ *******************************************************************************
+ * @brief Time until the next gesture timer of a finger that is down expires
+ *
+ * @param  pCurTime     IN      current time
+ *
+ * @retval  ms until gesture_state_machine_timeout() should be called
+ * @retval -1 if no timer is pending
+ *******************************************************************************
+ */
+int
+gesture_state_machine_get_timeout(const time_stamp_t *pCurTime)
+{
+	int timeout = -1;
+	GList *list;
+
+	for (list = g_list_first(sFingers); list; list = g_list_next(list))
+	{
+		finger_t *finger = (finger_t *)list->data;
+
+		if (finger->state.state != FINGER_DOWN_STATE ||
+		        !finger->state.insideTapRadius)
+		{
+			continue;
+		}
+
+		int remaining = spGeneralSettings->longPressTimeout -
+		                time_stamp_diff_ms(pCurTime, &finger->state.startTime);
+
+		if (remaining < 0)
+		{
+			remaining = 0;
+		}
+
+		if (timeout < 0 || remaining < timeout)
+		{
+			timeout = remaining;
+		}
+	}
+
+	return timeout;
+}
+
+/*
+ * Runs the gesture timers of the fingers that are down without reporting new
+ * coordinates, e.g. a finger that is held still for a long press.
+ */
+gesture_emit_status_t
+gesture_state_machine_timeout(const time_stamp_t *pCurTime,
+                              input_event_t *events, int maxEvents,
+                              int *numEvents)
+{
+	GList *list;
+
+	emit_begin(events, maxEvents);
+
+	for (list = g_list_first(sFingers); list; list = g_list_next(list))
+	{
+		finger_t *finger = (finger_t *)list->data;
+		int x, y;
+
+		if (finger->state.state != FINGER_DOWN_STATE ||
+		        !finger->state.insideTapRadius ||
+		        time_stamp_diff_ms(pCurTime, &finger->state.startTime) <
+		        spGeneralSettings->longPressTimeout)
+		{
+			continue;
+		}
+
+		get_last_coords(&finger->coords, &x, &y, NULL);
+
+		emit_event(pCurTime, EV_FINGERID, 0, finger->id);
+		emit_event(pCurTime, EV_ABS, ABS_X, x);
+		emit_event(pCurTime, EV_ABS, ABS_Y, y);
+		update_finger_timers(finger, x, y, pCurTime);
+	}
+
+	if (0 < sOut.frameEvents)
+	{
+		emit_event(pCurTime, EV_SYN, 0, 0);
+	}
+
+	return emit_end(numEvents);
 }
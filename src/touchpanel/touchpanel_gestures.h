@@ -28,6 +28,42 @@ typedef         __u32           uint32_t;
 
 
 #define EV_FINGERID 0x07
+#define EV_GESTURE  0x08
+
+/* codes of the EV_GESTURE pseudo events, attached to the current finger */
+#define GESTURE_CODE_KEY        0x00    /**< value is a gesture_key_t */
+#define GESTURE_CODE_VEL_X      0x01    /**< value is the x velocity in px/s */
+#define GESTURE_CODE_VEL_Y      0x02    /**< value is the y velocity in px/s */
+#define GESTURE_CODE_ITEM       0x03    /**< starts a gesture item that is not tied
+                                             to a finger, value is a gesture_key_t */
+#define GESTURE_CODE_WEIGHT     0x04    /**< value is the weight of the item in
+                                             units of 1/GESTURE_WEIGHT_SCALE */
+
+#define GESTURE_WEIGHT_SCALE    1000000
+
+/* values reported in the gestureKey field of the touch items */
+typedef enum
+{
+	GESTURE_KEY_NONE = -1,
+	GESTURE_KEY_TAP = 1,
+	GESTURE_KEY_DOUBLE_TAP,
+	GESTURE_KEY_LONG_PRESS,
+	GESTURE_KEY_FLICK,
+	GESTURE_KEY_PINCH,          /**< x,y: centroid, weight: scale since the
+                                     previous frame */
+	GESTURE_KEY_ROTATE,         /**< x,y: centroid, weight: rotation in degrees
+                                     since the previous frame */
+	GESTURE_KEY_PAN,            /**< x,y: centroid, xVelocity,yVelocity: movement
+                                     of the centroid in px since the previous frame */
+	GESTURE_KEY_EDGE_SWIPE_LEFT,    /**< x,y: finger position, xVelocity,yVelocity:
+                                         finger velocity in px/s. Reported once,
+                                         when a finger that went down at the
+                                         named edge has moved far enough away
+                                         from it */
+	GESTURE_KEY_EDGE_SWIPE_RIGHT,
+	GESTURE_KEY_EDGE_SWIPE_TOP,
+	GESTURE_KEY_EDGE_SWIPE_BOTTOM,
+} gesture_key_t;
 
 typedef struct time_stamp
 {
@@ -51,13 +87,51 @@ typedef struct interrupt_on_touch_settings
 } interrupt_on_touch_settings_t;
 
 
+typedef enum
+{
+	QUEUE_POLICY_WAIT = 0,      /**< stop reading until the consumer catches up */
+	QUEUE_POLICY_COALESCE       /**< keep only the newest of consecutive moves,
+                                     drop the oldest moves if that is not enough */
+} queue_policy_t;
+
 typedef struct general_settings
 {
 	int coordBufSize;           /**< size of coordinate circular buffer to calculate
                                      things such as avg velocity */
 	int fingerDownThreshold;            /**< threshold to accept finger as down -- access atomically */
-
-	int positionFilter;
+	int readerThread;           /**< 1 to read and process input on a thread of
+                                     the module, only looked at on open */
+	int queueSize;              /**< events the reader thread may queue up for
+                                     the consumer, only looked at on open */
+	int queuePolicy;            /**< what the reader thread does once that queue
+                                     is full, and the caller's thread once the
+                                     consumer falls behind, see queue_policy_t */
+
+	int positionFilter;         /**< 1 to smooth coordinates with the 1 euro filter */
+	double filterMinCutoff;     /**< Hz, cutoff of the position filter at rest */
+	double filterBeta;          /**< how fast the cutoff rises with the speed, per px */
+	double filterDerivativeCutoff;  /**< Hz, cutoff used to smooth the speed */
+
+	int tapRadius;              /**< px a finger may move and still be a tap */
+	int tapTimeout;             /**< ms a finger may stay down and still be a tap */
+	int doubleTapRadius;        /**< px between two taps of a double tap */
+	int doubleTapTimeout;       /**< ms between two taps of a double tap */
+	int longPressTimeout;       /**< ms a finger must stay inside the tap radius
+                                     to be reported as a long press */
+	int flickMinVelocity;       /**< px/s a finger must move with at release to
+                                     be reported as a flick */
+
+	int palmWeightThreshold;    /**< contacts at least this heavy are palms, 0 = off */
+	int edgeRejectWidth;        /**< px from the screen edge where new contacts
+                                     are rejected while another finger is on the
+                                     screen, 0 = off */
+
+	int edgeSwipeZone;          /**< % of the screen width or height from an edge
+                                     where a finger must go down to start an edge
+                                     swipe, 0 = off */
+	int edgeSwipeDistance;      /**< % of the screen width or height the finger
+                                     must then move away from the edge */
+	int edgeSwipeTimeout;       /**< ms the finger may take for that */
 } general_settings_t;
 
 typedef struct coord
@@ -67,6 +141,15 @@ typedef struct coord
 	time_stamp_t timeStamp;   /**< time of the coordinates */
 } coord_t;
 
+/* state of the position filter for one dimension of a finger */
+typedef struct one_euro_filter
+{
+	bool initialized;
+	double value;           /**< last filtered value */
+	double derivative;      /**< last filtered derivative, units/s */
+	time_stamp_t time;      /**< time of the last value */
+} one_euro_filter_t;
+
 typedef struct coord_buf
 {
 	coord_t *pCoords;       /**< array of coords */
@@ -83,8 +166,24 @@ typedef enum
 	FINGER_DOWN_STATE,                      /**< a finger is down */
 	FINGER_DOWN_AFTER_QUICK_LAUNCH,         /**< a quick launch was detected and we're
                                                waiting for the finger to come up */
+	FINGER_DOWN_AFTER_LONG_PRESS,           /**< a long press was reported and we're
+                                               waiting for the finger to come up */
+	FINGER_DOWN_AFTER_MULTI_FINGER,         /**< the finger was part of a multi finger
+                                               gesture and we're waiting for it to
+                                               come up */
+	FINGER_DOWN_AFTER_EDGE_SWIPE,           /**< an edge swipe was reported and we're
+                                               waiting for the finger to come up */
 } gesture_state_t;
 
+typedef enum
+{
+	EDGE_NONE = -1,
+	EDGE_LEFT = 0,
+	EDGE_RIGHT,
+	EDGE_TOP,
+	EDGE_BOTTOM
+} screen_edge_t;
+
 #define NUM_DIMENSIONS  2
 #define X_DIM   0
 #define Y_DIM   1
@@ -94,6 +193,7 @@ typedef struct gesture_state_data
 	gesture_state_t state;
 	int start[NUM_DIMENSIONS];
 	bool insideTapRadius;
+	screen_edge_t edge;         /**< edge the finger went down at */
 	time_stamp_t startTime;
 } gesture_state_data_t;
 
@@ -114,18 +214,33 @@ typedef struct finger
 	int minDist;
 	int minDistId;
 	int lastWeight;
-	int numEvents;
-	input_event_t *events;
+	one_euro_filter_t filter[NUM_DIMENSIONS];
 } finger_t;
 
+typedef enum
+{
+	GESTURE_EMIT_OK = 0,        /**< all events of the frame were written */
+	GESTURE_EMIT_PENDING,       /**< the buffer is full, the remaining events can
+                                     be fetched with gesture_state_machine_resume() */
+	GESTURE_EMIT_TRUNCATED,     /**< events were lost */
+} gesture_emit_status_t;
+
 
 
 void init_gesture_state_machine(const general_settings_t *pGeneralSettings,
                                 int maxFingers);
 void deinit_gesture_state_machine(void);
-void gesture_state_machine(int *pXCoords, int *pYCoords,
-                           const int *pFingerWeights,
-                           int fingerCount, const time_stamp_t *pTime,
-                           input_event_t *events, int *numEvents);
+gesture_emit_status_t gesture_state_machine(int *pXCoords, int *pYCoords,
+        const int *pFingerWeights,
+        int fingerCount, const time_stamp_t *pTime,
+        input_event_t *events, int maxEvents, int *numEvents);
+gesture_emit_status_t gesture_state_machine_resume(input_event_t *events,
+        int maxEvents, int *numEvents);
+int gesture_state_machine_pending(void);
+int gesture_state_machine_set_coord_buf_size(int bufSize);
+void gesture_state_machine_set_screen_size(int width, int height);
+int gesture_state_machine_get_timeout(const time_stamp_t *pCurTime);
+gesture_emit_status_t gesture_state_machine_timeout(const time_stamp_t *pCurTime,
+        input_event_t *events, int maxEvents, int *numEvents);
 
 #endif  /* __TOUCHPANEL_GESTURES_PRV_H */
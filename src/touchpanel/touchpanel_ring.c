@@ -0,0 +1,124 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <stdlib.h>
+
+#include "touchpanel_ring.h"
+
+/**
+ *******************************************************************************
+ * @brief Allocate an empty ring
+ *
+ * @param  pRing        OUT     the ring
+ * @param  size         IN      capacity in events, must be a power of 2
+ *
+ * @retval  0 on success
+ * @retval -1 on failure
+ *******************************************************************************
+ */
+int
+event_ring_init(event_ring_t *pRing, guint size)
+{
+	if (size == 0 || (size & (size - 1)) != 0)
+	{
+		return -1;
+	}
+
+	pRing->pEvents = malloc(size * sizeof(input_event_t));
+
+	if (NULL == pRing->pEvents)
+	{
+		return -1;
+	}
+
+	pRing->size = size;
+	pRing->head = 0;
+	pRing->tail = 0;
+
+	return 0;
+}
+
+void
+event_ring_free(event_ring_t *pRing)
+{
+	free(pRing->pEvents);
+	pRing->pEvents = NULL;
+	pRing->size = 0;
+}
+
+guint
+event_ring_count(event_ring_t *pRing)
+{
+	/* the counters wrap around together, so the difference stays right */
+	return (guint)g_atomic_int_get(&pRing->tail) -
+	       (guint)g_atomic_int_get(&pRing->head);
+}
+
+guint
+event_ring_space(event_ring_t *pRing)
+{
+	return pRing->size - event_ring_count(pRing);
+}
+
+/*
+ * Appends all of pEvents, or nothing if they don't fit, so the consumer never
+ * sees part of a frame. Only the producer may call this.
+ */
+bool
+event_ring_push(event_ring_t *pRing, const input_event_t *pEvents,
+                guint count)
+{
+	guint tail = (guint)pRing->tail;
+	guint i;
+
+	if (count > event_ring_space(pRing))
+	{
+		return false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		pRing->pEvents[(tail + i) & (pRing->size - 1)] = pEvents[i];
+	}
+
+	/* publish the events only once they are written */
+	g_atomic_int_set(&pRing->tail, (gint)(tail + count));
+
+	return true;
+}
+
+/*
+ * Oldest event in the ring, or NULL if it is empty. It stays valid until
+ * event_ring_pop(). Only the consumer may call this.
+ */
+const input_event_t *
+event_ring_peek(event_ring_t *pRing)
+{
+	guint head = (guint)pRing->head;
+
+	if (head == (guint)g_atomic_int_get(&pRing->tail))
+	{
+		return NULL;
+	}
+
+	return &pRing->pEvents[head & (pRing->size - 1)];
+}
+
+void
+event_ring_pop(event_ring_t *pRing)
+{
+	g_atomic_int_set(&pRing->head, (gint)((guint)pRing->head + 1));
+}
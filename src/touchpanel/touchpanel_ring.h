@@ -0,0 +1,51 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __TOUCHPANEL_RING_H
+#define __TOUCHPANEL_RING_H
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "touchpanel_gestures.h"
+
+/*
+ * Lock free ring of input events between exactly one producer thread and one
+ * consumer thread. head and tail count events since the ring was created and
+ * are only ever advanced, each by one side, so neither side needs a lock.
+ */
+typedef struct event_ring
+{
+	input_event_t *pEvents;
+	guint size;             /**< capacity, a power of 2 */
+	gint head;              /**< events consumed, written by the consumer */
+	gint tail;              /**< events produced, written by the producer */
+} event_ring_t;
+
+int event_ring_init(event_ring_t *pRing, guint size);
+void event_ring_free(event_ring_t *pRing);
+guint event_ring_count(event_ring_t *pRing);
+guint event_ring_space(event_ring_t *pRing);
+
+/* producer side */
+bool event_ring_push(event_ring_t *pRing, const input_event_t *pEvents,
+                     guint count);
+
+/* consumer side */
+const input_event_t *event_ring_peek(event_ring_t *pRing);
+void event_ring_pop(event_ring_t *pRing);
+
+#endif  /* __TOUCHPANEL_RING_H */
@@ -0,0 +1,229 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <glib.h>
+
+#include <nyx/module/nyx_log.h>
+
+#include "touchpanel_settings.h"
+#include "msgid.h"
+
+typedef enum
+{
+	SETTING_INT,
+	SETTING_DOUBLE
+} setting_type_t;
+
+typedef struct
+{
+	const char *group;
+	const char *key;
+	setting_type_t type;
+	size_t offset;
+	double min;
+	double max;
+} setting_desc_t;
+
+#define SETTING(group, key, field, min, max) \
+  { group, key, SETTING_INT, offsetof(general_settings_t, field), min, max }
+#define SETTING_DOUBLE(group, key, field, min, max) \
+  { group, key, SETTING_DOUBLE, offsetof(general_settings_t, field), min, max }
+
+static const setting_desc_t sSettingDescs[] =
+{
+	SETTING("General", "CoordBufSize", coordBufSize, 2, 64),
+	SETTING("General", "FingerDownThreshold", fingerDownThreshold, 0, INT_MAX),
+	SETTING("General", "ReaderThread", readerThread, 0, 1),
+	SETTING("General", "QueueSize", queueSize, 256, 4096),
+	SETTING("General", "QueuePolicy", queuePolicy, QUEUE_POLICY_WAIT,
+	        QUEUE_POLICY_COALESCE),
+	SETTING("Filter", "PositionFilter", positionFilter, 0, 1),
+	SETTING_DOUBLE("Filter", "MinCutoff", filterMinCutoff, 0.01, 1000.0),
+	SETTING_DOUBLE("Filter", "Beta", filterBeta, 0.0, 10.0),
+	SETTING_DOUBLE("Filter", "DerivativeCutoff", filterDerivativeCutoff, 0.01,
+	               1000.0),
+	SETTING("Gestures", "TapRadius", tapRadius, 0, 4096),
+	SETTING("Gestures", "TapTimeout", tapTimeout, 0, 10000),
+	SETTING("Gestures", "DoubleTapRadius", doubleTapRadius, 0, 4096),
+	SETTING("Gestures", "DoubleTapTimeout", doubleTapTimeout, 0, 10000),
+	SETTING("Gestures", "LongPressTimeout", longPressTimeout, 1, 60000),
+	SETTING("Gestures", "FlickMinVelocity", flickMinVelocity, 0, 100000),
+	SETTING("Rejection", "PalmWeight", palmWeightThreshold, 0, INT_MAX),
+	SETTING("Rejection", "EdgeWidth", edgeRejectWidth, 0, 4096),
+	SETTING("EdgeSwipe", "Zone", edgeSwipeZone, 0, 50),
+	SETTING("EdgeSwipe", "Distance", edgeSwipeDistance, 1, 100),
+	SETTING("EdgeSwipe", "Timeout", edgeSwipeTimeout, 1, 10000),
+};
+
+/**
+ *******************************************************************************
+ * @brief Override settings with the values found in a key file
+ *
+ * Keys that are missing keep their current value. If any key is invalid or
+ * out of range nothing is changed.
+ *
+ * @param  pPath        IN      path of the key file
+ * @param  pSettings    IN/OUT  settings to update
+ *
+ * @retval  0 on success
+ * @retval -1 on failure
+ *******************************************************************************
+ */
+int
+load_general_settings(const char *pPath, general_settings_t *pSettings)
+{
+	general_settings_t settings = *pSettings;
+	GKeyFile *keyFile = g_key_file_new();
+	GError *error = NULL;
+	int ret = -1;
+	size_t i;
+
+	if (!g_key_file_load_from_file(keyFile, pPath, G_KEY_FILE_NONE, &error))
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_SETTINGS_ERR, 0, "Failed to load %s: %s",
+		          pPath, error->message);
+		goto exit;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(sSettingDescs); i++)
+	{
+		const setting_desc_t *desc = &sSettingDescs[i];
+		double value;
+
+		if (!g_key_file_has_key(keyFile, desc->group, desc->key, NULL))
+		{
+			continue;
+		}
+
+		if (desc->type == SETTING_DOUBLE)
+		{
+			value = g_key_file_get_double(keyFile, desc->group, desc->key, &error);
+		}
+		else
+		{
+			value = g_key_file_get_integer(keyFile, desc->group, desc->key, &error);
+		}
+
+		if (error)
+		{
+			nyx_error(MSGID_NYX_QMUX_TP_SETTINGS_ERR, 0, "%s: invalid %s/%s: %s",
+			          pPath, desc->group, desc->key, error->message);
+			goto exit;
+		}
+
+		if (value < desc->min || value > desc->max)
+		{
+			nyx_error(MSGID_NYX_QMUX_TP_SETTINGS_ERR, 0,
+			          "%s: %s/%s out of range (%g, expected %g..%g)",
+			          pPath, desc->group, desc->key, value, desc->min, desc->max);
+			goto exit;
+		}
+
+		if (desc->type == SETTING_DOUBLE)
+		{
+			*(double *)((char *)&settings + desc->offset) = value;
+		}
+		else
+		{
+			*(int *)((char *)&settings + desc->offset) = (int)value;
+		}
+	}
+
+	*pSettings = settings;
+	ret = 0;
+
+exit:
+	g_clear_error(&error);
+	g_key_file_free(keyFile);
+	return ret;
+}
+
+/*
+ * Watches the directory of the settings file, so that editors that replace
+ * the file instead of rewriting it are noticed too.
+ *
+ * Returns a non blocking inotify fd, or -1.
+ */
+int
+watch_general_settings(const char *pPath)
+{
+	gchar *dir = g_path_get_dirname(pPath);
+	int watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (watchFd < 0)
+	{
+		nyx_error(MSGID_NYX_QMUX_TP_SETTINGS_ERR, 0, "inotify_init1 failed: %d",
+		          errno);
+		goto exit;
+	}
+
+	if (inotify_add_watch(watchFd, dir,
+	                      IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+	{
+		nyx_debug("Not watching %s for settings changes: %d", dir, errno);
+		close(watchFd);
+		watchFd = -1;
+	}
+
+exit:
+	g_free(dir);
+	return watchFd;
+}
+
+/*
+ * Drains the pending inotify events and returns true if any of them was
+ * about the settings file.
+ */
+bool
+general_settings_changed(int watchFd, const char *pPath)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	gchar *name = g_path_get_basename(pPath);
+	bool changed = false;
+	ssize_t len;
+
+	if (watchFd < 0)
+	{
+		g_free(name);
+		return false;
+	}
+
+	while ((len = read(watchFd, buf, sizeof(buf))) > 0)
+	{
+		char *p = buf;
+
+		while (p < buf + len)
+		{
+			const struct inotify_event *event = (const struct inotify_event *)p;
+
+			if (event->len && strcmp(event->name, name) == 0)
+			{
+				changed = true;
+			}
+
+			p += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	g_free(name);
+	return changed;
+}
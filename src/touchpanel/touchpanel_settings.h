@@ -0,0 +1,28 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __TOUCHPANEL_SETTINGS_H
+#define __TOUCHPANEL_SETTINGS_H
+
+#include <stdbool.h>
+
+#include "touchpanel_gestures.h"
+
+int load_general_settings(const char *pPath, general_settings_t *pSettings);
+int watch_general_settings(const char *pPath);
+bool general_settings_changed(int watchFd, const char *pPath);
+
+#endif  /* __TOUCHPANEL_SETTINGS_H */
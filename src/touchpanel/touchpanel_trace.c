@@ -0,0 +1,90 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <stdint.h>
+#include <time.h>
+
+#include "touchpanel_trace.h"
+#include "msgid.h"
+
+unsigned int tp_trace_counters[NUM_TP_TRACEPOINTS];
+
+static const char *const sTracepointNames[NUM_TP_TRACEPOINTS] =
+{
+	[TP_TRACE_FINGER_MATCHED] = "finger_matched",
+	[TP_TRACE_FINGER_NEW] = "finger_new",
+	[TP_TRACE_FINGER_DOWN] = "finger_down",
+	[TP_TRACE_FINGER_UP] = "finger_up",
+	[TP_TRACE_FINGER_REJECTED] = "finger_rejected",
+	[TP_TRACE_FINGER_LOW_WEIGHT] = "finger_low_weight",
+	[TP_TRACE_PALM_REJECTED] = "palm_rejected",
+	[TP_TRACE_EDGE_REJECTED] = "edge_rejected",
+	[TP_TRACE_COORD_IGNORED] = "coord_ignored",
+	[TP_TRACE_GESTURE] = "gesture",
+	[TP_TRACE_EVENTS_DEFERRED] = "events_deferred",
+	[TP_TRACE_EVENTS_DROPPED] = "events_dropped",
+	[TP_TRACE_FRAMES_COALESCED] = "frames_coalesced",
+	[TP_TRACE_FRAMES_DROPPED] = "frames_dropped",
+	[TP_TRACE_INPUT_DROPPED] = "input_dropped",
+};
+
+static struct
+{
+	int64_t lastMs;
+	unsigned int suppressed;
+} sRatelimit[NUM_TP_TRACEPOINTS];
+
+/*
+ * Returns true if a message of the tracepoint may be logged now, along with
+ * the number of messages that were suppressed since the last one.
+ */
+bool
+tp_trace_ratelimit(tp_tracepoint_t tp, unsigned int *pSuppressed)
+{
+	struct timespec now;
+	int64_t nowMs;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nowMs = now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+
+	if (sRatelimit[tp].lastMs &&
+	        nowMs - sRatelimit[tp].lastMs < TP_TRACE_RATELIMIT_MS)
+	{
+		sRatelimit[tp].suppressed++;
+		return false;
+	}
+
+	*pSuppressed = sRatelimit[tp].suppressed;
+	sRatelimit[tp].suppressed = 0;
+	sRatelimit[tp].lastMs = nowMs;
+
+	return true;
+}
+
+void
+tp_trace_dump_counters(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_TP_TRACEPOINTS; i++)
+	{
+		if (tp_trace_counters[i])
+		{
+			nyx_info(MSGID_NYX_QMUX_TP_TRACE_COUNTERS, 0, "%s: %u",
+			         sTracepointNames[i], tp_trace_counters[i]);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __TOUCHPANEL_TRACE_H
+#define __TOUCHPANEL_TRACE_H
+
+#include <stdbool.h>
+
+#include <nyx/module/nyx_log.h>
+
+/*
+ * Tracing for the touch hot path.
+ *
+ * Every tracepoint has a counter that is always kept, so the number of hits
+ * can be dumped even when the message itself is compiled out. Messages above
+ * TOUCHPANEL_TRACE_LEVEL are compiled out together with their arguments, the
+ * remaining ones are rate limited per tracepoint.
+ */
+
+#define TP_TRACE_LEVEL_NONE     0
+#define TP_TRACE_LEVEL_INFO     1
+#define TP_TRACE_LEVEL_DEBUG    2
+#define TP_TRACE_LEVEL_VERBOSE  3
+
+#ifndef TOUCHPANEL_TRACE_LEVEL
+#ifdef NDEBUG
+#define TOUCHPANEL_TRACE_LEVEL  TP_TRACE_LEVEL_INFO
+#else
+#define TOUCHPANEL_TRACE_LEVEL  TP_TRACE_LEVEL_VERBOSE
+#endif
+#endif
+
+/* minimum time between two messages of the same tracepoint */
+#define TP_TRACE_RATELIMIT_MS   1000
+
+typedef enum
+{
+	TP_TRACE_FINGER_MATCHED = 0,
+	TP_TRACE_FINGER_NEW,
+	TP_TRACE_FINGER_DOWN,
+	TP_TRACE_FINGER_UP,
+	TP_TRACE_FINGER_REJECTED,
+	TP_TRACE_FINGER_LOW_WEIGHT,
+	TP_TRACE_PALM_REJECTED,
+	TP_TRACE_EDGE_REJECTED,
+	TP_TRACE_COORD_IGNORED,
+	TP_TRACE_GESTURE,
+	TP_TRACE_EVENTS_DEFERRED,
+	TP_TRACE_EVENTS_DROPPED,
+	TP_TRACE_FRAMES_COALESCED,
+	TP_TRACE_FRAMES_DROPPED,
+	TP_TRACE_INPUT_DROPPED,
+	NUM_TP_TRACEPOINTS
+} tp_tracepoint_t;
+
+extern unsigned int tp_trace_counters[NUM_TP_TRACEPOINTS];
+
+bool tp_trace_ratelimit(tp_tracepoint_t tp, unsigned int *pSuppressed);
+void tp_trace_dump_counters(void);
+
+#define TP_TRACE_INFO(tp, msgid, fmt, args...)                            \
+  do {                                                                    \
+    unsigned int suppressed;                                              \
+    tp_trace_counters[tp]++;                                              \
+    if (TOUCHPANEL_TRACE_LEVEL >= TP_TRACE_LEVEL_INFO &&                  \
+        tp_trace_ratelimit(tp, &suppressed)) {                            \
+      nyx_info(msgid, 0, fmt " (%u suppressed)", ##args, suppressed);     \
+    }                                                                     \
+  } while(0)
+
+#define TP_TRACE_DEBUG_LEVEL(level, tp, fmt, args...)                     \
+  do {                                                                    \
+    unsigned int suppressed;                                              \
+    tp_trace_counters[tp]++;                                              \
+    if (TOUCHPANEL_TRACE_LEVEL >= level &&                                \
+        tp_trace_ratelimit(tp, &suppressed)) {                            \
+      nyx_debug(fmt " (%u suppressed)", ##args, suppressed);              \
+    }                                                                     \
+  } while(0)
+
+#define TP_TRACE_DEBUG(tp, fmt, args...) \
+  TP_TRACE_DEBUG_LEVEL(TP_TRACE_LEVEL_DEBUG, tp, fmt, ##args)
+#define TP_TRACE_VERBOSE(tp, fmt, args...) \
+  TP_TRACE_DEBUG_LEVEL(TP_TRACE_LEVEL_VERBOSE, tp, fmt, ##args)
+
+#endif  /* __TOUCHPANEL_TRACE_H */